@@ -9,8 +9,10 @@
 #include <glm/gtc/epsilon.hpp>
 #include <limits>
 #include <memory>
-#include <random>
+#include <atomic>
 #include <cmath>
+#include "rng.h"
+#include "sampling.h"
 
 extern std::ostream& operator<<(std::ostream& o, const glm::mat4& m);
 extern std::ostream& operator<<(std::ostream& o, const glm::mat3& m);
@@ -26,79 +28,88 @@ namespace glm
 const float pi = glm::pi<float>();
 const float infinity = std::numeric_limits<float>::infinity();
 
-inline float random_float() 
+// Sampling routines take their generator explicitly: an rng (rng.h) or a sampler
+// (sampler.h), anything with next_float(). The overloads without a generator draw
+// from a per-thread default and are meant for scene setup, not for rendering.
+inline rng& thread_rng()
 {
-   static std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
-   static std::mt19937 generator;
-   return distribution(generator); 
+   static std::atomic<uint32_t> next_thread(0);
+   static thread_local rng generator(0, 0, next_thread++);
+   return generator;
 }
 
-inline float random_float(float min, float max) 
+template <class Generator>
+inline float random_float(Generator& gen) 
 {
-   static std::uniform_real_distribution<float> distribution(min, max);
-   static std::mt19937 generator;
-   return distribution(generator);
+   return gen.next_float();
 }
 
-inline glm::vec3 random_unit_cube() 
+template <class Generator>
+inline float random_float(Generator& gen, float min, float max) 
 {
-   float x = random_float(-1,1);
-   float y = random_float(-1,1);
-   float z = random_float(-1,1);
+   return gen.next_float(min, max);
+}
+
+template <class Generator>
+inline glm::vec3 random_unit_cube(Generator& gen) 
+{
+   float x = random_float(gen, -1, 1);
+   float y = random_float(gen, -1, 1);
+   float z = random_float(gen, -1, 1);
    return glm::vec3(x, y, z);
 }
 
-inline glm::vec3 random_unit_square() 
+template <class Generator>
+inline glm::vec3 random_unit_square(Generator& gen) 
 {
-   float x = random_float(-1,1);
-   float y = random_float(-1,1);
+   float x = random_float(gen, -1, 1);
+   float y = random_float(gen, -1, 1);
    return glm::vec3(x, y, 0);
 }
 
-
-
-inline glm::vec3 random_unit_sphere() 
+// uniform point inside the unit ball
+template <class Generator>
+inline glm::vec3 random_unit_sphere(Generator& gen) 
 {
-   glm::vec3 p = random_unit_cube();
-   while (glm::length(p) >= 1.0f) 
-   {
-      p = random_unit_cube();
-   } 
-   return p;
+   float x = random_float(gen);
+   float y = random_float(gen);
+   float r = std::cbrt(random_float(gen));
+   return r * sample_uniform_sphere(glm::vec2(x, y));
 }
 
-inline glm::vec3 random_unit_disk()
+template <class Generator>
+inline glm::vec3 random_unit_disk(Generator& gen)
 {
-    glm::vec3 p = random_unit_square();
-    while (glm::length(p) >= 1.0f)
-    {
-        p = random_unit_square();
-    }
-    return p;
+   float x = random_float(gen);
+   float y = random_float(gen);
+   return sample_concentric_disk(glm::vec2(x, y));
 }
 
 // Generate random direction in hemisphere around normal
 // from https://raytracing.github.io/books/RayTracingInOneWeekend.html (Peter Shirley)
-inline glm::vec3 random_hemisphere(const glm::vec3& normal) 
+template <class Generator>
+inline glm::vec3 random_hemisphere(const glm::vec3& normal, Generator& gen) 
 {
-   glm::vec3 in_unit_sphere = random_unit_sphere();
-   if (glm::dot(in_unit_sphere, normal) > 0.0f) // In the same hemisphere as the normal
-   {
-       return in_unit_sphere;
-   }
-   else
-   {
-       return -in_unit_sphere;
-   }
+   glm::vec3 in_unit_sphere = random_unit_sphere(gen);
+   return glm::dot(in_unit_sphere, normal) > 0.0f ? in_unit_sphere : -in_unit_sphere;
 }
 
-// Generate random unit vector
-// from https://raytracing.github.io/books/RayTracingInOneWeekend.html (Peter Shirley)
-inline glm::vec3 random_unit_vector() 
+// Generate random unit vector, with a closed-form map instead of normalizing a point in the ball
+template <class Generator>
+inline glm::vec3 random_unit_vector(Generator& gen) 
 {
-   return glm::normalize(random_unit_sphere());
+   float x = random_float(gen);
+   float y = random_float(gen);
+   return sample_uniform_sphere(glm::vec2(x, y));
 }
 
+inline float random_float() { return random_float(thread_rng()); }
+inline float random_float(float min, float max) { return random_float(thread_rng(), min, max); }
+inline glm::vec3 random_unit_sphere() { return random_unit_sphere(thread_rng()); }
+inline glm::vec3 random_unit_disk() { return random_unit_disk(thread_rng()); }
+inline glm::vec3 random_hemisphere(const glm::vec3& normal) { return random_hemisphere(normal, thread_rng()); }
+inline glm::vec3 random_unit_vector() { return random_unit_vector(thread_rng()); }
+
 // test for vec3 close to zero (avoid numerical instability)
 // from https://raytracing.github.io/books/RayTracingInOneWeekend.html (Peter Shirley)
 inline bool near_zero(const glm::vec3& e) 
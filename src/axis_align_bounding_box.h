@@ -0,0 +1,76 @@
+// axis_align_bounding_box.h, based on https://raytracing.github.io by Peter Shirley, 2018-2020
+
+#ifndef AXIS_ALIGN_BOUNDING_BOX_H
+#define AXIS_ALIGN_BOUNDING_BOX_H
+
+#include "AGLM.h"
+#include "ray.h"
+#include <utility>
+
+class aabb {
+public:
+   aabb() : minimum(infinity), maximum(-infinity) {}
+   aabb(const glm::point3& a, const glm::point3& b) : minimum(a), maximum(b) {}
+
+   glm::point3 min() const { return minimum; }
+   glm::point3 max() const { return maximum; }
+
+   bool empty() const {
+      return minimum.x > maximum.x || minimum.y > maximum.y || minimum.z > maximum.z;
+   }
+
+   glm::point3 centroid() const {
+      return 0.5f * (minimum + maximum);
+   }
+
+   // grow the box so that it also contains p
+   void expand(const glm::point3& p) {
+      minimum = glm::min(minimum, p);
+      maximum = glm::max(maximum, p);
+   }
+
+   // grow the box so that it also contains b
+   void expand(const aabb& b) {
+      minimum = glm::min(minimum, b.minimum);
+      maximum = glm::max(maximum, b.maximum);
+   }
+
+   float surface_area() const {
+      if (empty()) return 0.0f;
+      glm::vec3 d = maximum - minimum;
+      return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+   }
+
+   // index of the axis with the largest extent
+   int longest_axis() const {
+      glm::vec3 d = maximum - minimum;
+      if (d.x > d.y && d.x > d.z) return 0;
+      return (d.y > d.z) ? 1 : 2;
+   }
+
+   // slab test against the interval [t_min, t_max], using the ray's cached inverse direction
+   inline bool hit(const ray& r, float t_min, float t_max) const {
+      const glm::vec3& inv_d = r.inv_direction();
+      for (int a = 0; a < 3; a++) {
+         float t0 = (minimum[a] - r.orig[a]) * inv_d[a];
+         float t1 = (maximum[a] - r.orig[a]) * inv_d[a];
+         if (inv_d[a] < 0.0f) std::swap(t0, t1);
+         t_min = t0 > t_min ? t0 : t_min;
+         t_max = t1 < t_max ? t1 : t_max;
+         if (t_max < t_min) return false;
+      }
+      return true;
+   }
+
+public:
+   glm::point3 minimum;
+   glm::point3 maximum;
+};
+
+inline aabb surrounding_box(const aabb& box0, const aabb& box1) {
+   aabb result = box0;
+   result.expand(box1);
+   return result;
+}
+
+#endif
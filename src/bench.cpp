@@ -0,0 +1,602 @@
+// bench.cpp
+// Performance benchmarks: hit() throughput of each primitive, and full renders
+// of the seven scenes in materials.cpp. Results are written as JSON so runs can
+// be compared to catch regressions.
+//
+// usage: bench [output.json] [width height]
+//        bench --scaling [output.json] [width height]
+// --scaling renders the solar system scene with 1, 2, 4, ... threads up to one per
+// hardware core, and reports the speedup over one thread.
+// Run from bin/ so that the scene textures in ../images are found; configure
+// with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+
+#include "AGLM.h"
+#include "ppm_image.h"
+#include "ray.h"
+#include "sphere.h"
+#include "moving_sphere.h"
+#include "triangle.h"
+#include "plane.h"
+#include "sphere_set.h"
+#include "triangle_mesh.h"
+#include "triangle_packet.h"
+#include "hittable_list.h"
+#include "bvh.h"
+#include "primitive_bvh.h"
+#include "instance.h"
+#include "mipmap.h"
+#include "texture_cache.h"
+#include "renderer.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+extern render_stats ray_trace_scene(agl::ppm_image& image, int cases, int num_threads, bool wavefront, bool save);
+
+struct bench_result {
+   string group; // "primitive", "triangle_test", "primary", "texture", "scene" or "scaling"
+   string name;
+   long long rays = 0;
+   double seconds = 0.0;
+   int threads = 1;
+   double hit_rate = -1.0; // fraction of rays that hit, for primitives
+
+   double rays_per_sec() const { return rays / seconds; }
+   double mrays_per_sec_per_core() const { return rays_per_sec() * 1e-6 / threads; }
+};
+
+// rays from points around the origin towards points inside a ball of radius 1.5,
+// so that about half of them hit an object of unit size at the origin
+vector<ray> make_rays(int count)
+{
+   rng gen(12345);
+   vector<ray> rays;
+   rays.reserve(count);
+   for (int k = 0; k < count; k++)
+   {
+      point3 origin = 4.0f * random_unit_vector(gen);
+      point3 target = 1.5f * random_unit_sphere(gen);
+      rays.push_back(ray(origin, target - origin, gen.next_float()));
+   }
+   return rays;
+}
+
+// unit sphere made of rows x 2 rows quads, split in triangles
+void make_uv_sphere(triangle_mesh& mesh, int rows)
+{
+   int cols = 2 * rows;
+   for (int i = 0; i <= rows; i++)
+   {
+      for (int j = 0; j <= cols; j++)
+      {
+         float theta = glm::pi<float>() * i / rows;
+         float phi = glm::two_pi<float>() * j / cols;
+         vec3 n(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+         mesh.positions.push_back(n);
+         mesh.normals.push_back(n);
+         mesh.uvs.push_back(vec2(float(j) / cols, float(i) / rows));
+      }
+   }
+   for (int i = 0; i < rows; i++)
+   {
+      for (int j = 0; j < cols; j++)
+      {
+         uint32_t a = i * (cols + 1) + j;
+         uint32_t b = a + 1, c = a + cols + 1, d = c + 1;
+         uint32_t quad[6] = { a, b, d, a, d, c };
+         mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+      }
+   }
+   mesh.build();
+}
+
+// calls object.hit for every ray, repeating until at least min_seconds have passed
+bench_result bench_hit(const string& name, const hittable& object, const vector<ray>& rays, double min_seconds = 0.5)
+{
+   bench_result result;
+   result.group = "primitive";
+   result.name = name;
+
+   long long hits = 0;
+   auto start = chrono::steady_clock::now();
+   do
+   {
+      hit_record rec;
+      for (const ray& r : rays)
+      {
+         if (object.hit(r, 0.001f, infinity, rec)) hits++;
+      }
+      result.rays += rays.size();
+      result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   } while (result.seconds < min_seconds);
+
+   result.hit_rate = double(hits) / result.rays;
+   return result;
+}
+
+// Cost of single ray/triangle tests: every ray against 64 triangles, one at a time
+// with triangle::intersect, or a packet at a time; rays counts the tests
+bench_result bench_triangle_tests(bool packets, const vector<ray>& rays, double min_seconds = 0.5)
+{
+   const int count = 64;
+   rng gen(777);
+   vector<triangle> triangles;
+   vector<triangle_packet> packed(count / triangle_packet::width);
+   for (int k = 0; k < count; k++)
+   {
+      point3 center = random_unit_sphere(gen);
+      point3 a = center + 0.3f * random_unit_vector(gen);
+      point3 b = center + 0.3f * random_unit_vector(gen);
+      point3 c = center + 0.3f * random_unit_vector(gen);
+      triangles.push_back(triangle(a, b, c, 0));
+      packed[k / triangle_packet::width].set(k % triangle_packet::width, a, b, c, k);
+   }
+
+   bench_result result;
+   result.group = "triangle_test";
+   result.name = packets ? string("triangle_packet_") + simd::name : "triangle_scalar";
+
+   long long hits = 0;
+   auto start = chrono::steady_clock::now();
+   do
+   {
+      for (const ray& r : rays)
+      {
+         if (packets)
+         {
+            watertight_ray wr(r);
+            for (const triangle_packet& packet : packed)
+            {
+               float t_max = infinity;
+               if (packet.intersect(wr, 0.001f, t_max) >= 0) hits++;
+            }
+         }
+         else
+         {
+            hit_record rec;
+            for (const triangle& tri : triangles)
+            {
+               if (tri.intersect(r, 0.001f, infinity, rec)) hits++;
+            }
+         }
+      }
+      result.rays += (long long) rays.size() * count;
+      result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   } while (result.seconds < min_seconds);
+
+   // packets report whether any of their triangles was hit
+   result.hit_rate = double(hits) / result.rays;
+   return result;
+}
+
+// Primary visibility: the camera rays of a 256x256 pinhole view of object, at the
+// center of each pixel, traced one at a time with hit() or in 8x8 ray_packets
+bench_result bench_primary(const string& name, const hittable& object, bool packets, double min_seconds = 0.5)
+{
+   const int size = 256;
+   const int block = 8;
+   point3 eye(0, 0, 4);
+   vector<ray> rays; // one 8x8 block after the other
+   for (int by = 0; by < size; by += block)
+   {
+      for (int bx = 0; bx < size; bx += block)
+      {
+         for (int k = 0; k < block * block; k++)
+         {
+            float x = (bx + k % block + 0.5f) / size - 0.5f;
+            float y = 0.5f - (by + k / block + 0.5f) / size;
+            rays.push_back(ray(eye, vec3(x, y, -1.0f)));
+         }
+      }
+   }
+
+   bench_result result;
+   result.group = "primary";
+   result.name = name + (packets ? "_packet" : "_single");
+
+   long long hits = 0;
+   ray_packet packet;
+   auto start = chrono::steady_clock::now();
+   do
+   {
+      if (packets)
+      {
+         for (size_t first = 0; first < rays.size(); first += block * block)
+         {
+            packet.clear();
+            for (int k = 0; k < block * block; k++) packet.add(rays[first + k]);
+            packet.finish();
+            object.intersect_packet(packet, 0, packet.size);
+            for (int k = 0; k < packet.size; k++)
+            {
+               if (!packet.hit[k]) continue;
+               packet.rec[k].object->finalize_hit(packet.rays[k], packet.rec[k]);
+               hits++;
+            }
+         }
+      }
+      else
+      {
+         hit_record rec;
+         for (const ray& r : rays)
+         {
+            if (object.hit(r, 0.001f, infinity, rec)) hits++;
+         }
+      }
+      result.rays += rays.size();
+      result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   } while (result.seconds < min_seconds);
+
+   result.hit_rate = double(hits) / result.rays;
+   return result;
+}
+
+// Texture lookups of a 128x128 pixel view of a whole texture, as on a distant planet,
+// one pixel after the other at a new random offset in the pixel each pass (a new
+// sample); lookup(s, t, dstdx, dstdy) returns the filtered color and rays counts
+// the lookups
+template <class Lookup>
+bench_result bench_texture(const string& name, const Lookup& lookup, double min_seconds = 0.5)
+{
+   const int size = 128;
+   vec2 dstdx(1.0f / size, 0.0f), dstdy(0.0f, 1.0f / size);
+
+   bench_result result;
+   result.group = "texture";
+   result.name = name;
+
+   rng gen(99);
+   color sum(0.0f);
+   auto start = chrono::steady_clock::now();
+   do
+   {
+      vec2 jitter(gen.next_float(), gen.next_float());
+      for (int y = 0; y < size; y++)
+      {
+         for (int x = 0; x < size; x++)
+         {
+            sum += lookup((x + jitter.x) / size, (y + jitter.y) / size, dstdx, dstdy);
+         }
+      }
+      result.rays += size * size;
+      result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   } while (result.seconds < min_seconds);
+
+   if (sum.x < 0.0f) cout << sum << endl; // keep the lookups
+   return result;
+}
+
+// bench_texture() on every thread of a pool at once, as render threads share a
+// texture; rays counts the lookups of all the threads
+template <class Lookup>
+bench_result bench_texture_threads(const string& name, const Lookup& lookup, int num_threads, double min_seconds = 0.5)
+{
+   thread_pool pool(num_threads);
+   vector<bench_result> parts(pool.size());
+   auto start = chrono::steady_clock::now();
+   pool.parallel_for(pool.size(), [&](int k, int worker)
+   {
+      parts[k] = bench_texture(name, lookup, min_seconds);
+   });
+
+   bench_result result = parts[0];
+   result.rays = 0;
+   for (const bench_result& part : parts) result.rays += part.rays;
+   result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   result.threads = pool.size();
+   return result;
+}
+
+// render a scene of materials.cpp without saving it; num_threads 0 => one per core
+bench_result bench_scene(const string& name, int cases, int width, int height, int num_threads = 0,
+   bool wavefront = false)
+{
+   agl::ppm_image image(width, height);
+   render_stats stats = ray_trace_scene(image, cases, num_threads, wavefront, false);
+
+   bench_result result;
+   result.group = num_threads > 0 ? "scaling" : "scene";
+   result.name = name;
+   result.rays = stats.rays;
+   result.seconds = stats.seconds;
+   result.threads = stats.threads;
+   return result;
+}
+
+string to_json(const vector<bench_result>& results, int width, int height)
+{
+   ostringstream out;
+   out << "{\n";
+   out << "  \"image\": { \"width\": " << width << ", \"height\": " << height << " },\n";
+   out << "  \"benchmarks\": [\n";
+   for (size_t k = 0; k < results.size(); k++)
+   {
+      const bench_result& r = results[k];
+      out << "    { \"group\": \"" << r.group << "\", \"name\": \"" << r.name << "\""
+         << ", \"rays\": " << r.rays
+         << ", \"seconds\": " << r.seconds
+         << ", \"threads\": " << r.threads
+         << ", \"rays_per_sec\": " << r.rays_per_sec()
+         << ", \"mrays_per_sec_per_core\": " << r.mrays_per_sec_per_core();
+      if (r.hit_rate >= 0) out << ", \"hit_rate\": " << r.hit_rate;
+      out << " }" << (k + 1 < results.size() ? "," : "") << "\n";
+   }
+   out << "  ]\n";
+   out << "}\n";
+   return out.str();
+}
+
+// the solar system scene with 1, 2, 4, ... threads and then one per hardware core;
+// the speedup is the rays per second over those with one thread
+vector<bench_result> bench_scaling(int width, int height)
+{
+   int cores = std::max(1, (int) thread::hardware_concurrency());
+   vector<int> counts;
+   for (int n = 1; n < cores; n *= 2) counts.push_back(n);
+   counts.push_back(cores);
+
+   // decode the textures and warm the caches first
+   bench_scene("solar_system", 6, width, height, cores);
+
+   vector<bench_result> results;
+   for (int n : counts)
+   {
+      results.push_back(bench_scene("solar_system_" + to_string(n) + "_threads", 6, width, height, n));
+   }
+   cout << "threads  Mrays/s  speedup  efficiency" << endl;
+   for (const bench_result& r : results)
+   {
+      double speedup = r.rays_per_sec() / results[0].rays_per_sec();
+      cout << r.threads << "  " << r.rays_per_sec() * 1e-6 << "  " << speedup << "x  " <<
+         100.0 * speedup / r.threads << "%" << endl;
+   }
+   return results;
+}
+
+int main(int argc, char** argv)
+{
+   bool scaling = argc > 1 && strcmp(argv[1], "--scaling") == 0;
+   if (scaling)
+   {
+      argc--;
+      argv++;
+   }
+   string output = argc > 1 ? argv[1] : (scaling ? "bench_scaling.json" : "bench_results.json");
+   int width = argc > 3 ? atoi(argv[2]) : 320;
+   int height = argc > 3 ? atoi(argv[3]) : 180;
+
+   vector<bench_result> results;
+   if (scaling)
+   {
+      results = bench_scaling(width, height);
+      string json = to_json(results, width, height);
+      ofstream file(output);
+      file << json;
+      cout << "Saved results to " << output << endl;
+      return 0;
+   }
+
+   uint32_t gray = 0; // hit() only passes the material id along
+   vector<ray> rays = make_rays(1 << 16);
+   results.push_back(bench_hit("sphere", sphere(point3(0), 1.0f, gray), rays));
+   results.push_back(bench_hit("moving_sphere", moving_sphere(point3(-0.25f, 0, 0), point3(0.25f, 0, 0), 0.0, 1.0, 1.0, gray), rays));
+   results.push_back(bench_hit("triangle", triangle(point3(-1, -1, 0), point3(1, -1, 0), point3(0, 1, 0), gray), rays));
+   results.push_back(bench_hit("plane", plane(point3(0), vec3(0, 1, 0), gray), rays));
+
+   // a cluster of 64 small spheres, as separate objects and as one sphere_set
+   rng gen(54321);
+   hittable_list spheres;
+   sphere_set cluster;
+   for (int k = 0; k < 64; k++)
+   {
+      point3 center = random_unit_sphere(gen);
+      float radius = random_float(gen, 0.05f, 0.2f);
+      spheres.add(make_shared<sphere>(center, radius, gray));
+      cluster.add(center, radius, gray);
+   }
+   results.push_back(bench_hit("sphere_list_64", spheres, rays));
+   results.push_back(bench_hit("sphere_bvh_64", bvh_node(spheres), rays));
+   primitive_bvh typed_spheres;
+   for (const auto& object : spheres.objects) typed_spheres.add(static_cast<const sphere*>(object.get()));
+   typed_spheres.build();
+   results.push_back(bench_hit("sphere_primitive_bvh_64", typed_spheres, rays));
+   results.push_back(bench_hit(string("sphere_set_64_") + simd::name, cluster, rays));
+
+   // 1000 small spheres drifting together by ten times their size during the shutter,
+   // with nodes bounding their whole swept volume or interpolated to the time of each ray
+   hittable_list movers;
+   for (int k = 0; k < 1000; k++)
+   {
+      point3 center = 1.2f * random_unit_sphere(gen);
+      vec3 motion = vec3(0.5f, 0.0f, 0.0f) + 0.1f * random_unit_sphere(gen);
+      movers.add(make_shared<moving_sphere>(center, center + motion, 0.0, 1.0, 0.05f, gray));
+   }
+   primitive_bvh swept_movers, motion_movers;
+   swept_movers.motion_bounds = false;
+   for (const auto& object : movers.objects)
+   {
+      swept_movers.add(static_cast<const moving_sphere*>(object.get()));
+      motion_movers.add(static_cast<const moving_sphere*>(object.get()));
+   }
+   swept_movers.build(0.0f, 1.0f);
+   motion_movers.build(0.0f, 1.0f);
+   results.push_back(bench_hit("moving_sphere_swept_bvh_1k", swept_movers, rays));
+   results.push_back(bench_hit("moving_sphere_motion_bvh_1k", motion_movers, rays));
+
+   // one animation step of the same spheres: a new build against update(), which refits
+   // the boxes and rebuilds only subtrees that got much worse
+   for (const auto& object : movers.objects)
+   {
+      moving_sphere* s = static_cast<moving_sphere*>(object.get());
+      vec3 step = 0.02f * random_unit_sphere(gen);
+      s->center0 += step;
+      s->center1 += step;
+   }
+   auto update_start = chrono::steady_clock::now();
+   motion_movers.update();
+   auto build_start = chrono::steady_clock::now();
+   motion_movers.build(0.0f, 1.0f);
+   auto build_end = chrono::steady_clock::now();
+   cout << "1000 moving spheres: build " << chrono::duration<double, milli>(build_end - build_start).count() <<
+      " ms, update " << chrono::duration<double, milli>(build_start - update_start).count() << " ms" << endl;
+
+   // a sphere of 20000 triangles, as triangle objects and as one triangle_mesh
+   triangle_mesh mesh(gray);
+   make_uv_sphere(mesh, 100);
+   hittable_list triangles;
+   for (size_t k = 0; k < mesh.num_triangles(); k++)
+   {
+      const uint32_t* v = &mesh.indices[3 * k];
+      triangles.add(make_shared<triangle>(mesh.positions[v[0]], mesh.positions[v[1]], mesh.positions[v[2]], gray));
+   }
+   results.push_back(bench_hit("triangle_bvh_20k", bvh_node(triangles), rays));
+   primitive_bvh typed_triangles;
+   for (const auto& object : triangles.objects) typed_triangles.add(static_cast<const triangle*>(object.get()));
+   typed_triangles.build();
+   results.push_back(bench_hit("triangle_primitive_bvh_20k", typed_triangles, rays));
+   results.push_back(bench_hit("triangle_mesh_20k", mesh, rays));
+
+   // a 4x4x4 grid of that sphere, as 64 instances of the mesh and as 64 transformed copies
+   vector<instance> placements;
+   vector<triangle_mesh> copies(64, triangle_mesh(gray));
+   placements.reserve(64);
+   for (int k = 0; k < 64; k++)
+   {
+      vec3 offset = 0.5f * vec3(k % 4, (k / 4) % 4, k / 16) - vec3(0.75f);
+      mat4 transform = glm::translate(mat4(1.0f), offset) *
+         glm::rotate(mat4(1.0f), random_float(gen, 0.0f, 6.28f), vec3(0, 1, 0)) *
+         glm::scale(mat4(1.0f), vec3(0.2f, 0.25f, 0.2f));
+      placements.push_back(instance(&mesh, transform));
+      copies[k] = mesh;
+      for (point3& p : copies[k].positions) p = vec3(transform * vec4(p, 1.0f));
+      mat3 normal_transform = glm::transpose(glm::inverse(mat3(transform)));
+      for (vec3& n : copies[k].normals) n = glm::normalize(normal_transform * n);
+      copies[k].build();
+   }
+   primitive_bvh instanced_meshes, copied_meshes;
+   for (int k = 0; k < 64; k++)
+   {
+      instanced_meshes.add(&placements[k]);
+      copied_meshes.add(&copies[k]);
+   }
+   instanced_meshes.build();
+   copied_meshes.build();
+   results.push_back(bench_hit("triangle_mesh_copies_64x20k", copied_meshes, rays));
+   results.push_back(bench_hit("triangle_mesh_instances_64x20k", instanced_meshes, rays));
+   cout << "64 mesh copies: " << 64 * copies[0].memory_bytes() / 1e6 << " MB, 64 instances: " <<
+      (mesh.memory_bytes() + 64 * sizeof(instance)) / 1e6 << " MB" << endl;
+
+   results.push_back(bench_triangle_tests(false, rays));
+   results.push_back(bench_triangle_tests(true, rays));
+
+   // camera rays one at a time and in packets, through the same hierarchies
+   bvh_node sphere_bvh(spheres);
+   bvh_node triangle_bvh(triangles);
+   results.push_back(bench_primary("sphere_bvh_64", sphere_bvh, false));
+   results.push_back(bench_primary("sphere_bvh_64", sphere_bvh, true));
+   results.push_back(bench_primary("triangle_bvh_20k", triangle_bvh, false));
+   results.push_back(bench_primary("triangle_bvh_20k", triangle_bvh, true));
+   results.push_back(bench_primary("sphere_primitive_bvh_64", typed_spheres, false));
+   results.push_back(bench_primary("sphere_primitive_bvh_64", typed_spheres, true));
+   results.push_back(bench_primary("triangle_primitive_bvh_20k", typed_triangles, false));
+   results.push_back(bench_primary("triangle_primitive_bvh_20k", typed_triangles, true));
+
+   // a 4096x2048 texture, 32 texels per pixel of the view: nearest lookups in a row-major
+   // image (as image_texture did before mipmaps), bilinear in the full image and trilinear
+   const int tex_width = 4096, tex_height = 2048;
+   vector<unsigned char> pixels((size_t) tex_width * tex_height * 3);
+   for (size_t k = 0; k < pixels.size(); k++) pixels[k] = (unsigned char) (gen.next_float() * 256.0f);
+   mipmap levels(pixels.data(), tex_width, tex_height);
+   results.push_back(bench_texture("texture_nearest_row_major", [&](float s, float t, vec2, vec2) -> color
+   {
+      int i = std::min(int(s * tex_width), tex_width - 1);
+      int j = std::min(int(t * tex_height), tex_height - 1);
+      const unsigned char* p = &pixels[((size_t) j * tex_width + i) * 3];
+      return (1.0f / 255.0f) * color(p[0], p[1], p[2]);
+   }));
+   results.push_back(bench_texture("texture_bilinear_tiled", [&](float s, float t, vec2, vec2) -> color
+   {
+      return levels.bilinear(0, s, t);
+   }));
+   results.push_back(bench_texture("texture_trilinear_tiled", [&](float s, float t, vec2 dx, vec2 dy) -> color
+   {
+      return levels.trilinear(s, t, dx, dy);
+   }));
+
+   // the same texture kept in the compact texel formats, trilinear
+   const texel_format formats[] = { texel_format::srgb8, texel_format::half, texel_format::bc1 };
+   const char* format_names[] = { "srgb8", "half", "bc1" };
+   cout << "texture memory: unorm8 " << levels.memory_bytes() / 1e6 << " MB";
+   for (int f = 0; f < 3; f++)
+   {
+      mipmap compact(pixels.data(), tex_width, tex_height, 3, formats[f]);
+      cout << ", " << format_names[f] << " " << compact.memory_bytes() / 1e6 << " MB";
+      results.push_back(bench_texture(string("texture_trilinear_") + format_names[f],
+         [&](float s, float t, vec2 dx, vec2 dy) -> color
+      {
+         return compact.trilinear(s, t, dx, dy);
+      }));
+   }
+   cout << endl;
+
+   // lookups in the earth texture through a texture_cache, leased as image_texture
+   // does, against the same mip chain without the cache; then on one thread per core
+   // at once, all reading the same texture
+   texture_cache cache;
+   shared_ptr<texture_cache::entry> earth = cache.find("../images/earth.jpg");
+   // decode before timing, and copy the texels for the uncached lookups while they
+   // are leased; a lease only holds them while it is in scope
+   bool earth_loaded = false;
+   mipmap earth_texels;
+   {
+      texture_cache::lease texels = cache.acquire(*earth);
+      if (texels.get())
+      {
+         earth_texels = *texels.get();
+         earth_loaded = true;
+      }
+   }
+   if (earth_loaded)
+   {
+      results.push_back(bench_texture("texture_earth_trilinear", [&](float s, float t, vec2 dx, vec2 dy) -> color
+      {
+         return earth_texels.trilinear(s, t, dx, dy);
+      }));
+      auto cached_lookup = [&](float s, float t, vec2 dx, vec2 dy) -> color
+      {
+         texture_cache::lease texels = cache.acquire(*earth);
+         return texels.get()->trilinear(s, t, dx, dy);
+      };
+      int cores = std::max(1, (int) thread::hardware_concurrency());
+      results.push_back(bench_texture_threads("texture_earth_cache_1_thread", cached_lookup, 1));
+      if (cores > 1)
+      {
+         results.push_back(bench_texture_threads("texture_earth_cache_" + to_string(cores) + "_threads", cached_lookup, cores));
+      }
+   }
+
+   const char* scenes[] = { "checker_texture", "materials", "image_texture", "light_sources",
+      "defocus_blur", "motion_blur", "solar_system" };
+   for (int cases = 0; cases < 7; cases++)
+   {
+      results.push_back(bench_scene(scenes[cases], cases, width, height));
+      // the wavefront renderer on the same scene; light_sources always renders one path at a time
+      if (cases != 3) results.push_back(bench_scene(string(scenes[cases]) + "_wavefront", cases, width, height, 0, true));
+   }
+
+   string json = to_json(results, width, height);
+   ofstream file(output);
+   file << json;
+   cout << json;
+   cout << "Saved results to " << output << endl;
+   return 0;
+}
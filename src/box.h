@@ -6,19 +6,26 @@
 
 class box : public hittable {
 public:
-   box() : c(0), ax(0), ay(0), az(0), hx(0), hy(0), hz(0), mat_ptr(0) {}
+   box() : c(0), ax(0), ay(0), az(0), hx(0), hy(0), hz(0), mat_id(0) {}
    box(const glm::point3& center, 
        const glm::vec3& xdir, const glm::vec3& ydir, const glm::vec3& zdir,
        const glm::vec3& halfx, const glm::vec3& halfy, const glm::vec3& halfz,
-       std::shared_ptr<material> m) : c(center), ax(xdir), ay(ydir), az(zdir), 
-          hx(halfx), hy(halfy), hz(halfz), mat_ptr(m) {};
+       uint32_t m) : c(center), ax(xdir), ay(ydir), az(zdir), 
+          hx(halfx), hy(halfy), hz(halfz), mat_id(m) {};
 
-   virtual bool hit(const ray& r, hit_record& rec) const override
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override
    {
       // todo
       return false;
    }
 
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override
+   {
+      glm::vec3 extent = glm::abs(hx) + glm::abs(hy) + glm::abs(hz);
+      output_box = aabb(c - extent, c + extent);
+      return true;
+   }
+
 public:
    glm::vec3 c;
    glm::vec3 ax;
@@ -27,7 +34,7 @@ public:
    glm::vec3 hx;
    glm::vec3 hy;
    glm::vec3 hz;
-   std::shared_ptr<material> mat_ptr;
+   uint32_t mat_id; // index into the scene's material_table
 };
 
 #endif
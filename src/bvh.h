@@ -0,0 +1,269 @@
+// bvh.h, based on https://raytracing.github.io by Peter Shirley, 2018-2020
+// the tree is built with a binned surface area heuristic instead of random axis splits
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "axis_align_bounding_box.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// an object together with its cached bounds, used while building the tree
+struct bvh_primitive {
+   shared_ptr<hittable> object;
+   aabb box;
+   glm::point3 centroid;
+};
+
+class bvh_node : public hittable {
+public:
+   bvh_node() : axis(0) {}
+   bvh_node(const hittable_list& list, float time0 = 0.0f, float time1 = 0.0f);
+   bvh_node(std::vector<bvh_primitive>& prims, size_t start, size_t end);
+
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override;
+   virtual void intersect_packet(ray_packet& packet, int first, int last) const override;
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override;
+
+public:
+   shared_ptr<hittable> left;  // primitives with the smaller centroids along axis
+   shared_ptr<hittable> right; // null when the tree holds a single primitive
+   aabb box;
+   int axis; // split axis, used to visit the nearer child first
+   std::vector<shared_ptr<hittable>> unbounded; // objects without a box (only on the root)
+
+private:
+   void build(std::vector<bvh_primitive>& prims, size_t start, size_t end);
+   static shared_ptr<hittable> make_child(std::vector<bvh_primitive>& prims, size_t start, size_t end);
+};
+
+// Partition prims[start, end) in two along the binned split with the lowest
+// surface area cost, and return the index of the first primitive of the second
+// half. Prim is any type with an aabb box and a point3 centroid; centroid_bounds
+// holds the centroids of the range, and the split axis is returned in axis.
+template <class Prim>
+size_t sah_split(std::vector<Prim>& prims, size_t start, size_t end, const aabb& centroid_bounds, int& axis);
+
+inline bvh_node::bvh_node(const hittable_list& list, float time0, float time1) : axis(0)
+{
+   std::vector<bvh_primitive> prims;
+   prims.reserve(list.objects.size());
+   for (const auto& object : list.objects)
+   {
+      bvh_primitive prim;
+      prim.object = object;
+      if (object->bounding_box(time0, time1, prim.box))
+      {
+         prim.centroid = prim.box.centroid();
+         prims.push_back(prim);
+      }
+      else
+      {
+         unbounded.push_back(object);
+      }
+   }
+
+   if (!prims.empty())
+   {
+      build(prims, 0, prims.size());
+   }
+}
+
+inline bvh_node::bvh_node(std::vector<bvh_primitive>& prims, size_t start, size_t end) : axis(0)
+{
+   build(prims, start, end);
+}
+
+inline void bvh_node::build(std::vector<bvh_primitive>& prims, size_t start, size_t end)
+{
+   aabb centroid_bounds;
+   for (size_t i = start; i < end; i++)
+   {
+      box.expand(prims[i].box);
+      centroid_bounds.expand(prims[i].centroid);
+   }
+
+   if (end - start == 1)
+   {
+      left = prims[start].object;
+      return;
+   }
+
+   size_t mid = sah_split(prims, start, end, centroid_bounds, axis);
+   left = make_child(prims, start, mid);
+   right = make_child(prims, mid, end);
+}
+
+inline shared_ptr<hittable> bvh_node::make_child(std::vector<bvh_primitive>& prims, size_t start, size_t end)
+{
+   // single primitives are stored directly as children, without a wrapping node
+   if (end - start == 1)
+   {
+      return prims[start].object;
+   }
+   return make_shared<bvh_node>(prims, start, end);
+}
+
+template <class Prim>
+size_t sah_split(std::vector<Prim>& prims, size_t start, size_t end, const aabb& centroid_bounds, int& axis)
+{
+   const int num_bins = 12;
+   struct bin {
+      aabb box;
+      int count = 0;
+   };
+
+   float best_cost = infinity;
+   int best_axis = -1;
+   int best_bin = 0;
+
+   for (int a = 0; a < 3; a++)
+   {
+      float extent = centroid_bounds.maximum[a] - centroid_bounds.minimum[a];
+      if (extent <= 0.0f) continue;
+
+      bin bins[num_bins];
+      float scale = num_bins / extent;
+      for (size_t i = start; i < end; i++)
+      {
+         int b = std::min(num_bins - 1, int((prims[i].centroid[a] - centroid_bounds.minimum[a]) * scale));
+         bins[b].count++;
+         bins[b].box.expand(prims[i].box);
+      }
+
+      // sweep from the right to get the cost of everything above each split plane
+      float right_area[num_bins];
+      int right_count[num_bins];
+      aabb right_box;
+      int count = 0;
+      for (int b = num_bins - 1; b > 0; b--)
+      {
+         right_box.expand(bins[b].box);
+         count += bins[b].count;
+         right_area[b] = right_box.surface_area();
+         right_count[b] = count;
+      }
+
+      // sweep from the left; split b puts bins [0, b] on the left
+      aabb left_box;
+      count = 0;
+      for (int b = 0; b < num_bins - 1; b++)
+      {
+         left_box.expand(bins[b].box);
+         count += bins[b].count;
+         if (count == 0 || right_count[b + 1] == 0) continue;
+
+         float cost = count * left_box.surface_area() + right_count[b + 1] * right_area[b + 1];
+         if (cost < best_cost)
+         {
+            best_cost = cost;
+            best_axis = a;
+            best_bin = b;
+         }
+      }
+   }
+
+   size_t mid = start;
+   if (best_axis >= 0)
+   {
+      axis = best_axis;
+      float min_c = centroid_bounds.minimum[axis];
+      float scale = num_bins / (centroid_bounds.maximum[axis] - min_c);
+      auto it = std::partition(prims.begin() + start, prims.begin() + end,
+         [=](const Prim& p) {
+            return std::min(num_bins - 1, int((p.centroid[axis] - min_c) * scale)) <= best_bin;
+         });
+      mid = it - prims.begin();
+   }
+
+   if (mid == start || mid == end)
+   {
+      // all centroids coincide: fall back to splitting in the middle
+      axis = centroid_bounds.longest_axis();
+      mid = start + (end - start) / 2;
+      int a = axis;
+      std::nth_element(prims.begin() + start, prims.begin() + mid, prims.begin() + end,
+         [=](const Prim& p, const Prim& q) { return p.centroid[a] < q.centroid[a]; });
+   }
+
+   return mid;
+}
+
+inline bool bvh_node::intersect(const ray& r, float t_min, float t_max, hit_record& rec) const
+{
+   bool hit_anything = false;
+   float closest_so_far = t_max;
+
+   for (const auto& object : unbounded)
+   {
+      if (object->intersect(r, t_min, closest_so_far, rec))
+      {
+         hit_anything = true;
+         closest_so_far = rec.t;
+      }
+   }
+
+   if (!left || !box.hit(r, t_min, closest_so_far))
+   {
+      return hit_anything;
+   }
+
+   // visit the child on the near side of the split first, so the far one is culled more often
+   const hittable* first = left.get();
+   const hittable* second = right.get();
+   if (second && r.dir[axis] < 0.0f)
+   {
+      std::swap(first, second);
+   }
+
+   if (first->intersect(r, t_min, closest_so_far, rec))
+   {
+      hit_anything = true;
+      closest_so_far = rec.t;
+   }
+
+   if (second && second->intersect(r, t_min, closest_so_far, rec))
+   {
+      hit_anything = true;
+   }
+
+   return hit_anything;
+}
+
+// the packet walks the tree once, and each node passes down the range of rays
+// from the first to the last that enter its box
+inline void bvh_node::intersect_packet(ray_packet& packet, int first, int last) const
+{
+   for (const auto& object : unbounded)
+   {
+      object->intersect_packet(packet, first, last);
+   }
+
+   if (!left) return;
+   first = packet.first_hit(box, first, last);
+   if (first == last) return;
+   last = packet.last_hit(box, first, last);
+
+   const hittable* nearer = left.get();
+   const hittable* farther = right.get();
+   if (farther && packet.rays[first].dir[axis] < 0.0f)
+   {
+      std::swap(nearer, farther);
+   }
+
+   nearer->intersect_packet(packet, first, last);
+   if (farther) farther->intersect_packet(packet, first, last);
+}
+
+inline bool bvh_node::bounding_box(float time0, float time1, aabb& output_box) const
+{
+   if (!unbounded.empty() || !left) return false;
+   output_box = box;
+   return true;
+}
+
+#endif
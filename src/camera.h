@@ -5,17 +5,22 @@
 #define CAMERA_H
 
 #include "AGLM.h"
+#include "ray.h"
+#include "sampler.h"
 #include <cmath>
 
 class camera 
 {
 public:
-   camera() : origin(0), horizontal(2, 0, 0), vertical(0, 2, 0)
+   camera() : origin(0), horizontal(2, 0, 0), vertical(0, 2, 0), 
+      u(1, 0, 0), v(0, 1, 0), w(0, 0, 1), lens_radius(0), time0(0), time1(0)
    {
       lower_left_corner = origin - horizontal * 0.5f - vertical * 0.5f - glm::vec3(0,0,1);
    }
 
-   camera(glm::point3 pos, float viewport_height, float aspect_ratio, float focal_length) 
+   camera(glm::point3 pos, float viewport_height, float aspect_ratio, float focal_length,
+          float startTime = 0, float endTime = 0) : 
+      u(1, 0, 0), v(0, 1, 0), w(0, 0, 1), lens_radius(0), time0(startTime), time1(endTime)
    {
       origin = pos;
       float viewport_width = aspect_ratio * viewport_height;
@@ -54,12 +59,22 @@ public:
        time1 = endTime;
    }
 
-   virtual ray get_ray(float s, float t) const
+   virtual ray get_ray(float s, float t, sampler& gen) const
    {
-       glm::vec3 rd = lens_radius * random_unit_disk();
+       glm::vec3 rd = lens_radius * sample_concentric_disk(gen.get_2d());
        glm::vec3 offset = u * rd.x + v * rd.y;
 
-       return ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset, random_float(time0, time1));
+       return ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset, gen.next_float(time0, time1));
+   }
+
+   // get_ray() with ray differentials (ray.h); ds and dt are the steps in s and t
+   // from one pixel to the next, e.g. 1 / (width - 1), or less with many samples per pixel
+   ray get_ray_differential(float s, float t, float ds, float dt, sampler& gen) const
+   {
+       // the offset rays go through the same point on the lens
+       ray r = get_ray(s, t, gen);
+       r.set_differentials(r.orig, r.dir + ds * horizontal, r.orig, r.dir + dt * vertical);
+       return r;
    }
 
 protected:
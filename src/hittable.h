@@ -6,18 +6,32 @@
 
 #include "ray.h"
 #include <sstream>
-//#include "axis_align_bounding_box.h"
+#include <cstdint>
+#include <algorithm>
+#include "axis_align_bounding_box.h"
+#include "sampler.h"
 
 class material;
+class hittable;
 
 struct hit_record {
    glm::point3 p; // the hit position
    glm::vec3 normal; // the normal at the hit position
    float t = -1.0f; // the time t along the ray at which we hit the object
    bool front_face = false; // whether this is a front or back facing hit point
-   float u;
-   float v;
-   std::shared_ptr<material> mat_ptr = 0; // save material of hit object
+   float u = 0.0f; // texture coordinates at the hit position
+   float v = 0.0f;
+   uint32_t mat_id = 0; // material of the hit object, an index into the scene's material_table
+   const hittable* object = nullptr; // primitive that was hit, which fills in p, normal, u and v
+   uint32_t prim = 0; // for objects made of many primitives (e.g. sphere_set), which one was hit
+   const hittable* instanced = nullptr; // for hits on an instance (the object), what was hit in its geometry
+
+   // change of p, normal, u and v from one pixel to the next, in x and in y; only
+   // set when the ray has differentials, see hittable::compute_differentials()
+   bool has_differentials = false;
+   glm::vec3 dpdx, dpdy;
+   glm::vec3 dndx, dndy;
+   glm::vec2 duvdx = glm::vec2(0), duvdy = glm::vec2(0);
 
    inline void set_face_normal(const ray& r, const glm::vec3& outward_normal) {
       front_face = glm::dot(r.direction(), outward_normal) < 0;
@@ -34,12 +48,189 @@ struct hit_record {
    }
 };
 
+// Up to 64 coherent rays, e.g. the camera rays of an 8x8 block of pixels, traced
+// through the scene together by hittable::intersect_packet(). Besides the rays
+// and their closest hits, the packet keeps interval bounds on its origins and
+// inverse directions, so that a box missed by every ray is culled with one test.
+struct ray_packet {
+   static const int max_size = 64;
+
+   ray_packet() : size(0), t_min(0.001f), coherent(false) {}
+
+   void clear() { size = 0; }
+
+   void add(const ray& r) {
+      rays[size] = r;
+      t_max[size] = infinity;
+      hit[size] = false;
+      size++;
+   }
+
+   // compute the bounds used by first_hit(); call it once all rays are added
+   void finish() {
+      org_lo = org_hi = rays[0].orig;
+      inv_lo = inv_hi = rays[0].inv_dir;
+      coherent = true;
+      for (int k = 0; k < size; k++)
+      {
+         org_lo = glm::min(org_lo, rays[k].orig);
+         org_hi = glm::max(org_hi, rays[k].orig);
+         inv_lo = glm::min(inv_lo, rays[k].inv_dir);
+         inv_hi = glm::max(inv_hi, rays[k].inv_dir);
+         // the interval test needs every direction component to keep one sign
+         for (int a = 0; a < 3; a++)
+         {
+            if (!(rays[k].dir[a] * rays[0].dir[a] > 0.0f)) coherent = false;
+         }
+      }
+   }
+
+   // the first ray in [first, last) whose interval meets box; last if none does
+   int first_hit(const aabb& box, int first, int last) const {
+      if (box.hit(rays[first], t_min, t_max[first])) return first;
+      if (coherent && !may_hit(box)) return last;
+      for (int k = first + 1; k < last; k++)
+      {
+         if (box.hit(rays[k], t_min, t_max[k])) return k;
+      }
+      return last;
+   }
+
+   // one past the last ray in [first, last) whose interval meets box, given that ray first does
+   int last_hit(const aabb& box, int first, int last) const {
+      for (int k = last - 1; k > first; k--)
+      {
+         if (box.hit(rays[k], t_min, t_max[k])) return k + 1;
+      }
+      return first + 1;
+   }
+
+   // Interval version of the slab test: with the origins and inverse directions
+   // known only to lie in [lo, hi], bound the entry and exit distances of every
+   // ray. False when no ray of the packet can enter the box.
+   bool may_hit(const aabb& box) const {
+      float entry = t_min;
+      float exit = infinity;
+      for (int a = 0; a < 3; a++)
+      {
+         bool positive = rays[0].dir[a] > 0.0f;
+         float near_plane = positive ? box.minimum[a] : box.maximum[a];
+         float far_plane = positive ? box.maximum[a] : box.minimum[a];
+         entry = std::max(entry, lowest(near_plane - org_hi[a], near_plane - org_lo[a], inv_lo[a], inv_hi[a]));
+         exit = std::min(exit, highest(far_plane - org_hi[a], far_plane - org_lo[a], inv_lo[a], inv_hi[a]));
+      }
+      return entry <= exit;
+   }
+
+   ray rays[max_size];
+   hit_record rec[max_size]; // closest hit of each ray, valid where hit is set
+   float t_max[max_size]; // distance to the closest hit so far
+   bool hit[max_size];
+   int size;
+   float t_min;
+
+   // bounds over the rays, for may_hit(); coherent when each direction component has one sign
+   bool coherent;
+   glm::point3 org_lo, org_hi;
+   glm::vec3 inv_lo, inv_hi;
+
+private:
+   // smallest and largest product of x in [x0, x1] and y in [y0, y1]
+   static float lowest(float x0, float x1, float y0, float y1) {
+      return std::min(std::min(x0 * y0, x0 * y1), std::min(x1 * y0, x1 * y1));
+   }
+   static float highest(float x0, float x1, float y0, float y1) {
+      return std::max(std::max(x0 * y0, x0 * y1), std::max(x1 * y0, x1 * y1));
+   }
+};
+
 class hittable {
 public:
-   //virtual bool hit(const ray& r, hit_record& rec) const = 0;
-   virtual bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const = 0;
+   // Intersection is split in two. intersect() looks for the closest hit with t in
+   // [t_min, t_max] and only sets rec.t, rec.mat_id and rec.object; it leaves rec
+   // alone when there is no such hit. finalize_hit() then computes the surface
+   // attributes (p, normal, front_face, u, v), once per ray, for the closest hit only.
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const = 0;
+   virtual void finalize_hit(const ray& r, hit_record& rec) const {}
+
+   // closest hit with all of its attributes
+   bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
+      if (!intersect(r, t_min, t_max, rec)) return false;
+      rec.object->finalize_hit(r, rec);
+      compute_differentials(r, rec);
+      return true;
+   }
+
+   // intersect() for the rays [first, last) of the packet, keeping the closest hit of
+   // each; the other rays are known to miss. Aggregates override this to walk their
+   // hierarchy once for the whole packet.
+   virtual void intersect_packet(ray_packet& packet, int first, int last) const {
+      for (int k = first; k < last; k++)
+      {
+         if (intersect(packet.rays[k], packet.t_min, packet.t_max[k], packet.rec[k]))
+         {
+            packet.t_max[k] = packet.rec[k].t;
+            packet.hit[k] = true;
+         }
+      }
+   }
+
+   // box enclosing the object over the shutter interval [time0, time1];
+   // returns false for unbounded objects, e.g. planes
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const = 0;
+
+   // light sampling, from https://raytracing.github.io (The Rest of Your Life):
+   // density over solid angle of the direction from origin towards this object
+   virtual float pdf_value(const glm::point3& origin, const glm::vec3& direction) const {
+      return 0.0f;
+   }
+   // random direction from origin towards this object
+   virtual glm::vec3 random(const glm::point3& origin, sampler& gen) const {
+      return glm::vec3(1, 0, 0);
+   }
    virtual ~hittable() {}
+
+   // Change of the normal and of (u, v) of a finalized hit of r when moving by dp, a
+   // small step in the tangent plane at rec.p. By default, the hit is finalized again
+   // at rec.p + dp, at the time of r; primitives with a cheaper closed form override this.
+   virtual void surface_differential(const ray& r, const hit_record& rec, const glm::vec3& dp, glm::vec3& dn, glm::vec2& duv) const;
+
+   // Differentials of a finalized hit of r (hit_record::dpdx and so on): each of the
+   // ray's offset rays is taken to the plane tangent to the surface at rec.p. Without
+   // ray differentials, the derivatives of u and v are zero.
+   static void compute_differentials(const ray& r, hit_record& rec);
 };
 
+inline void hittable::surface_differential(const ray& r, const hit_record& rec, const glm::vec3& dp, glm::vec3& dn, glm::vec2& duv) const
+{
+   // a ray that meets the surface at rec.p + dp from the side rec.normal faces, at
+   // t = 1, and at the same time as r, so moving objects are where r saw them
+   hit_record moved = rec;
+   moved.t = 1.0f;
+   finalize_hit(ray(rec.p + dp + rec.normal, -rec.normal, r.getTime()), moved);
+   dn = moved.normal - rec.normal;
+   // texture coordinates that wrap around, e.g. at the seam of a sphere, jump by
+   // 1 there; take the shorter way around
+   duv = glm::vec2(moved.u - rec.u, moved.v - rec.v);
+   duv -= glm::round(duv);
+}
+
+inline void hittable::compute_differentials(const ray& r, hit_record& rec)
+{
+   rec.has_differentials = false;
+   rec.duvdx = rec.duvdy = glm::vec2(0);
+   if (!r.has_differentials) return;
+
+   float x_cosine = glm::dot(rec.normal, r.rx_dir);
+   float y_cosine = glm::dot(rec.normal, r.ry_dir);
+   if (x_cosine == 0.0f || y_cosine == 0.0f) return; // an offset ray is parallel to the surface
+
+   rec.has_differentials = true;
+   rec.dpdx = r.rx_orig + (glm::dot(rec.normal, rec.p - r.rx_orig) / x_cosine) * r.rx_dir - rec.p;
+   rec.dpdy = r.ry_orig + (glm::dot(rec.normal, rec.p - r.ry_orig) / y_cosine) * r.ry_dir - rec.p;
+   rec.object->surface_differential(r, rec, rec.dpdx, rec.dndx, rec.duvdx);
+   rec.object->surface_differential(r, rec, rec.dpdy, rec.dndy, rec.duvdy);
+}
+
 #endif
 
@@ -12,7 +12,7 @@
 using std::shared_ptr;
 using std::make_shared;
 
-class hittable_list {
+class hittable_list : public hittable {
 public:
    hittable_list() {}
    hittable_list(shared_ptr<hittable> object) { add(object); }
@@ -20,33 +20,46 @@ public:
    void clear() { objects.clear(); }
    void add(shared_ptr<hittable> object) { objects.push_back(object); }
 
-   virtual bool hit(const ray& r, float min_t, float max_t, hit_record& rec) const;
+   virtual bool intersect(const ray& r, float min_t, float max_t, hit_record& rec) const override;
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override;
 
 public:
    std::vector<shared_ptr<hittable>> objects;
 };
 
-bool hittable_list::hit(const ray& r, float min_t, float max_t, hit_record& rec) const 
+// objects only write to rec for a hit closer than closest_so_far, so rec ends up
+// holding the closest hit without copying records around
+inline bool hittable_list::intersect(const ray& r, float min_t, float max_t, hit_record& rec) const 
 {
-   hit_record temp_rec;
    bool hit_anything = false;
    float closest_so_far = max_t;
 
    for (const auto& object : objects) 
    {
-      if (object->hit(r, min_t, closest_so_far, temp_rec)) 
+      if (object->intersect(r, min_t, closest_so_far, rec)) 
       {
-         if (temp_rec.t >= min_t && temp_rec.t <= closest_so_far) 
-         {
-            hit_anything = true;
-            closest_so_far = std::min(closest_so_far, temp_rec.t);
-            rec = temp_rec;
-         }
+         hit_anything = true;
+         closest_so_far = rec.t;
       }
    }
 
    return hit_anything;
 }
 
+inline bool hittable_list::bounding_box(float time0, float time1, aabb& output_box) const 
+{
+   if (objects.empty()) return false;
+
+   aabb temp_box;
+   output_box = aabb();
+   for (const auto& object : objects) 
+   {
+      if (!object->bounding_box(time0, time1, temp_box)) return false;
+      output_box.expand(temp_box);
+   }
+
+   return true;
+}
+
 #endif
 
@@ -0,0 +1,131 @@
+// instance.h
+// A placement of shared geometry. An instance refers to a bottom-level object,
+// e.g. a triangle_mesh, a sphere_set or a primitive_bvh of its own, through an
+// affine transform, so a scene can hold many copies of an asset while storing its
+// primitives and hierarchy once. Rays are moved into the object's space instead
+// of the object into the scene: the direction is not normalized there, so t is
+// the same in both spaces and hits compare with the rest of the scene directly.
+//
+// Instances go in a scene like any other object, and the scene's primitive_bvh
+// over them is the top level. To move an instance, call set_transform() and then
+// update() the scene, which refits the top level; the shared geometry is untouched.
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "hittable.h"
+#include "AGLM.h"
+
+class instance : public hittable {
+public:
+   // object is not owned and must outlive the instance (see scene::create), and must
+   // not be an instance itself; transform takes object space to world space
+   instance(const hittable* object, const glm::mat4& transform) : object(object) {
+      set_transform(transform);
+   }
+
+   // transform must be affine and invertible
+   void set_transform(const glm::mat4& transform) {
+      linear = glm::mat3(transform);
+      inverse_linear = glm::inverse(linear);
+      translation = glm::vec3(transform[3]);
+   }
+
+   glm::mat4 transform() const {
+      glm::mat4 m(linear);
+      m[3] = glm::vec4(translation, 1.0f);
+      return m;
+   }
+
+   const hittable* geometry() const { return object; }
+
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override;
+   virtual void finalize_hit(const ray& r, hit_record& rec) const override;
+   virtual void intersect_packet(ray_packet& packet, int first, int last) const override;
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override;
+
+private:
+   ray to_object(const ray& r) const {
+      return ray(inverse_linear * (r.orig - translation), inverse_linear * r.dir, r.time);
+   }
+
+   const hittable* object;
+   glm::mat3 linear; // object to world, without the translation
+   glm::mat3 inverse_linear;
+   glm::vec3 translation;
+};
+
+inline bool instance::intersect(const ray& r, float t_min, float t_max, hit_record& rec) const
+{
+   if (!object->intersect(to_object(r), t_min, t_max, rec)) return false;
+   // finalize_hit() goes through the instance, which knows the transform
+   rec.instanced = rec.object;
+   rec.object = this;
+   return true;
+}
+
+inline void instance::finalize_hit(const ray& r, hit_record& rec) const
+{
+   rec.instanced->finalize_hit(to_object(r), rec);
+
+   // normals transform with the inverse transpose; the side the normal faces
+   // relative to the ray does not change, so front_face still holds
+   rec.p = r.at(rec.t);
+   rec.normal = glm::normalize(glm::transpose(inverse_linear) * rec.normal);
+}
+
+inline void instance::intersect_packet(ray_packet& packet, int first, int last) const
+{
+   // trace the whole packet in object space, then put the world rays and bounds back
+   ray world_rays[ray_packet::max_size];
+   float t_before[ray_packet::max_size];
+   glm::point3 org_lo = packet.org_lo, org_hi = packet.org_hi;
+   glm::vec3 inv_lo = packet.inv_lo, inv_hi = packet.inv_hi;
+   bool coherent = packet.coherent;
+
+   for (int k = 0; k < packet.size; k++)
+   {
+      world_rays[k] = packet.rays[k];
+      packet.rays[k] = to_object(world_rays[k]);
+   }
+   for (int k = first; k < last; k++) t_before[k] = packet.t_max[k];
+   packet.finish();
+
+   object->intersect_packet(packet, first, last);
+
+   // a hit in the object shortens t_max; the object alone does not tell, since the
+   // ray may already hold a hit on the same geometry placed directly in the scene
+   for (int k = first; k < last; k++)
+   {
+      if (packet.t_max[k] < t_before[k])
+      {
+         packet.rec[k].instanced = packet.rec[k].object;
+         packet.rec[k].object = this;
+      }
+   }
+   for (int k = 0; k < packet.size; k++) packet.rays[k] = world_rays[k];
+   packet.org_lo = org_lo;
+   packet.org_hi = org_hi;
+   packet.inv_lo = inv_lo;
+   packet.inv_hi = inv_hi;
+   packet.coherent = coherent;
+}
+
+inline bool instance::bounding_box(float time0, float time1, aabb& output_box) const
+{
+   aabb box;
+   if (!object->bounding_box(time0, time1, box)) return false;
+
+   // box around the transformed corners
+   output_box = aabb();
+   for (int corner = 0; corner < 8; corner++)
+   {
+      glm::point3 p((corner & 1) ? box.maximum.x : box.minimum.x,
+         (corner & 2) ? box.maximum.y : box.minimum.y,
+         (corner & 4) ? box.maximum.z : box.minimum.z);
+      output_box.expand(linear * p + translation);
+   }
+   return true;
+}
+
+#endif
@@ -0,0 +1,179 @@
+// integrator.h
+// Path evaluation shared by the ray tracers. Paths are traced in a loop that
+// carries the product of the attenuations so far (the throughput) instead of
+// recursing once per bounce. Once a path's throughput is low, it is ended
+// with Russian roulette, and survivors are re-weighted so the image stays unbiased.
+
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "AGLM.h"
+#include "ray.h"
+#include "hittable.h"
+#include "material.h"
+#include "light_list.h"
+#include "scene.h"
+
+struct path_settings {
+   path_settings(int depth = 10) : max_depth(depth), rr_min_depth(3), rr_threshold(0.5f), rr_min_survival(0.05f) {}
+
+   // after rr_min_depth bounces, a path whose largest throughput component m is below
+   // rr_threshold survives with probability max(rr_min_survival, m / rr_threshold)
+   bool russian_roulette(glm::color& throughput, int bounce, sampler& gen) const {
+      if (bounce < rr_min_depth) return true;
+
+      float m = std::max(throughput.r, std::max(throughput.g, throughput.b));
+      if (m >= rr_threshold) return true;
+
+      float survival = std::max(rr_min_survival, m / rr_threshold);
+      if (gen.get_1d() >= survival) return false;
+      throughput /= survival;
+      return true;
+   }
+
+   int max_depth; // hard limit on the number of bounces
+   int rr_min_depth; // bounces before russian roulette starts; a large value disables it
+   float rr_threshold;
+   float rr_min_survival;
+};
+
+inline glm::color sky_color(const ray& r)
+{
+   glm::vec3 unit_direction = glm::normalize(r.direction());
+   float t = 0.5f * (unit_direction.y + 1.0f);
+   return (1.0f - t) * glm::color(1, 1, 1) + t * glm::color(0.5f, 0.7f, 1.0f);
+}
+
+// ray_color() for a camera ray whose first intersection was already traced (e.g. in a
+// ray_packet): hit tells whether there was one, and rec holds it with all its attributes
+inline glm::color ray_color(const ray& r_in, bool hit, hit_record rec, const scene& world,
+   const path_settings& settings, sampler& gen)
+{
+   glm::color throughput(1);
+   ray r = r_in;
+   for (int bounce = 1; bounce <= settings.max_depth; bounce++)
+   {
+      if (bounce > 1)
+      {
+         thread_ray_count()++;
+         hit = world.hit(r, 0.001f, infinity, rec);
+      }
+      if (!hit)
+      {
+         return throughput * sky_color(r);
+      }
+
+      ray scattered;
+      glm::color attenuation;
+      gen.start_bounce(bounce); // each bounce has its own sample dimensions
+      if (!world.material_of(rec).scatter(r, rec, attenuation, scattered, gen))
+      {
+         return throughput * attenuation;
+      }
+
+      throughput *= attenuation;
+      if (!settings.russian_roulette(throughput, bounce, gen))
+      {
+         break;
+      }
+      r = scattered;
+   }
+   return glm::color(0);
+}
+
+// path tracing under a sky; materials that do not scatter return their attenuation as color
+inline glm::color ray_color(const ray& r, const scene& world, const path_settings& settings, sampler& gen)
+{
+   hit_record rec;
+   thread_ray_count()++;
+   bool hit = world.hit(r, 0.001f, infinity, rec);
+   return ray_color(r, hit, rec, world, settings, gen);
+}
+
+// shadow ray from a diffuse hit towards a point on a light, weighted against the
+// chance of the diffuse bounce finding the same light
+inline glm::color direct_light(const ray& r, const hit_record& rec, const glm::color& attenuation,
+   const scene& world, const light_list& lights, sampler& gen)
+{
+   glm::vec3 to_light = lights.random(rec.p, gen);
+   float cosine = glm::dot(glm::normalize(to_light), rec.normal);
+   float light_pdf = lights.pdf_value(rec.p, to_light);
+
+   hit_record light_rec;
+   thread_ray_count()++;
+   if (cosine <= 0 || light_pdf <= 0 || !world.hit(ray(rec.p, to_light, r.getTime()), 0.001f, infinity, light_rec))
+   {
+      return glm::color(0);
+   }
+
+   glm::color light_emit = world.material_of(light_rec).emitted(light_rec.u, light_rec.v, light_rec.p);
+   float weight = power_heuristic(light_pdf, cosine_hemisphere_pdf(cosine));
+   return attenuation * glm::one_over_pi<float>() * light_emit * cosine * weight / light_pdf;
+}
+
+// ray_color_emit() for a camera ray whose first intersection was already traced,
+// as for ray_color() above
+inline glm::color ray_color_emit(const ray& r_in, bool hit, hit_record rec, const glm::color& background,
+   const scene& world, const light_list& lights, const path_settings& settings, sampler& gen)
+{
+   glm::color radiance(0);
+   glm::color throughput(1);
+   float bsdf_pdf = 0.0f; // density of the diffuse bounce that produced r; 0 for camera and specular rays
+   ray r = r_in;
+   for (int bounce = 1; bounce <= settings.max_depth; bounce++)
+   {
+      if (bounce > 1)
+      {
+         thread_ray_count()++;
+         hit = world.hit(r, 0.001f, infinity, rec);
+      }
+      if (!hit)
+      {
+         return radiance + throughput * background;
+      }
+
+      glm::color emit_color = world.material_of(rec).emitted(rec.u, rec.v, rec.p);
+      if (bsdf_pdf > 0 && !lights.empty())
+      {
+         // this light may also have been sampled directly at the previous hit
+         emit_color *= power_heuristic(bsdf_pdf, lights.pdf_value(r.origin(), r.direction()));
+      }
+      radiance += throughput * emit_color;
+
+      ray scattered;
+      glm::color attenuation;
+      gen.start_bounce(bounce); // each bounce has its own sample dimensions
+      if (!world.material_of(rec).scatter(r, rec, attenuation, scattered, gen))
+      {
+         break;
+      }
+
+      bsdf_pdf = 0.0f;
+      if (world.material_of(rec).is_diffuse() && !lights.empty())
+      {
+         radiance += throughput * direct_light(r, rec, attenuation, world, lights, gen);
+         bsdf_pdf = cosine_hemisphere_pdf(glm::dot(glm::normalize(scattered.direction()), rec.normal));
+      }
+
+      throughput *= attenuation;
+      if (!settings.russian_roulette(throughput, bounce, gen))
+      {
+         break;
+      }
+      r = scattered;
+   }
+   return radiance;
+}
+
+// path tracing with emitting materials and a constant background;
+// at diffuse hits the lights are also sampled directly (next-event estimation)
+inline glm::color ray_color_emit(const ray& r, const glm::color& background, const scene& world,
+   const light_list& lights, const path_settings& settings, sampler& gen)
+{
+   hit_record rec;
+   thread_ray_count()++;
+   bool hit = world.hit(r, 0.001f, infinity, rec);
+   return ray_color_emit(r, hit, rec, background, world, lights, settings, gen);
+}
+
+#endif
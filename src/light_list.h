@@ -0,0 +1,72 @@
+// light_list.h
+// The emitting objects of a scene, used for next-event estimation: at each
+// diffuse hit a direction towards a light is sampled and tested with a shadow ray.
+
+#ifndef LIGHT_LIST_H
+#define LIGHT_LIST_H
+
+#include "hittable_list.h"
+#include "material.h"
+#include "scene.h"
+#include "sphere.h"
+#include "triangle.h"
+
+#include <memory>
+#include <vector>
+
+class light_list {
+public:
+   light_list() {}
+
+   // collect every sphere and triangle with an emit_light material
+   light_list(const scene& world) {
+      for (const auto& object : world.objects.objects)
+      {
+         if (is_light(object, world.materials)) add(object);
+      }
+   }
+
+   void add(shared_ptr<hittable> object) { objects.push_back(object); }
+   bool empty() const { return objects.empty(); }
+
+   // pick a light uniformly, then a direction towards it
+   glm::vec3 random(const glm::point3& origin, sampler& gen) const {
+      int index = std::min((int) objects.size() - 1, int(gen.get_1d() * objects.size()));
+      return objects[index]->random(origin, gen);
+   }
+
+   // density of random() over solid angle; the mixture of every light that
+   // direction passes through, whether or not another object is in front of it
+   float pdf_value(const glm::point3& origin, const glm::vec3& direction) const {
+      float sum = 0.0f;
+      for (const auto& object : objects)
+      {
+         sum += object->pdf_value(origin, direction);
+      }
+      return sum / objects.size();
+   }
+
+   static bool is_light(const shared_ptr<hittable>& object, const material_table& materials) {
+      const hittable* h = object.get();
+      if (auto s = dynamic_cast<const sphere*>(h)) return is_emitter(materials[s->mat_id]);
+      if (auto t = dynamic_cast<const triangle*>(h)) return is_emitter(materials[t->mat_id]);
+      return false;
+   }
+
+   static bool is_emitter(const material& m) {
+      return dynamic_cast<const emit_light*>(&m) != nullptr;
+   }
+
+public:
+   std::vector<shared_ptr<hittable>> objects;
+};
+
+// multiple importance sampling weight for a sample drawn with density pdf_a,
+// when it could also have been drawn with density pdf_b (Veach's power heuristic)
+inline float power_heuristic(float pdf_a, float pdf_b) {
+   float a = pdf_a * pdf_a;
+   float b = pdf_b * pdf_b;
+   return (a + b) > 0.0f ? a / (a + b) : 0.0f;
+}
+
+#endif
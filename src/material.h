@@ -12,7 +12,10 @@ public:
     virtual glm::color emitted(double u, double v, const glm::point3& p) const {
         return glm::color(0, 0, 0);
     }
-    virtual bool scatter(const ray& r_in, const hit_record& rec, glm::color& attenuation, ray& scattered) const = 0;
+    virtual bool scatter(const ray& r_in, const hit_record& rec, glm::color& attenuation, ray& scattered, sampler& gen) const = 0;
+    // true for materials that scatter with a cosine-weighted lambertian lobe,
+    // i.e. brdf = attenuation / pi; these can also be lit by sampling the lights
+    virtual bool is_diffuse() const { return false; }
     virtual ~material() {}
 };
 
@@ -22,7 +25,7 @@ public:
     emit_light(shared_ptr<texture> a) : emit(a) {}
     emit_light(glm::color c) : emit(make_shared<constant_texture>(c)) {}
 
-    virtual bool scatter(const ray& r_in, const hit_record& rec, glm::color& attenuation, ray& scattered) const override 
+    virtual bool scatter(const ray& r_in, const hit_record& rec, glm::color& attenuation, ray& scattered, sampler& gen) const override 
     {
         return false;
     }
@@ -41,19 +44,23 @@ public:
     lambertian(shared_ptr<texture> a) : albedo(a) {}
 
   virtual bool scatter(const ray& r_in, const hit_record& rec, 
-     glm::color& attenuation, ray& scattered) const override 
+     glm::color& attenuation, ray& scattered, sampler& gen) const override 
   {
       using namespace glm;
-      vec3 scatter_direction = rec.normal + random_unit_vector();
-      if (near_zero(scatter_direction)) 
+      vec3 scatter_direction = sample_cosine_direction(rec.normal, gen.get_2d());
+      scattered = ray(rec.p, scatter_direction, r_in.getTime());
+      if (rec.has_differentials)
       {
-          scatter_direction = rec.normal;
+          // a diffuse bounce spreads far wider than this; the footprint is only
+          // carried over, so that it does not shrink below the pixel's
+          scattered.set_differentials(rec.p + rec.dpdx, scatter_direction, rec.p + rec.dpdy, scatter_direction);
       }
-      scattered = ray(rec.p, scatter_direction, r_in.getTime());
-      attenuation = albedo->value(rec.u, rec.v, rec.p);
+      attenuation = albedo->value(rec.u, rec.v, rec.p, rec.duvdx, rec.duvdy);
       return true;
   }
 
+  virtual bool is_diffuse() const override { return true; }
+
 public:
     shared_ptr<texture> albedo;
 };
@@ -83,7 +90,7 @@ public:
   {}
 
   virtual bool scatter(const ray& r_in, const hit_record& hit, 
-     glm::color& attenuation, ray& scattered) const override 
+     glm::color& attenuation, ray& scattered, sampler& gen) const override 
   {
       glm::color Ia = ka * ambientColor;
 
@@ -114,10 +121,18 @@ public:
    metal(const glm::color& a, float f) : albedo(a), fuzz(glm::clamp(f,0.0f,1.0f)) {}
 
    virtual bool scatter(const ray& r_in, const hit_record& rec, 
-      glm::color& attenuation, ray& scattered) const override 
+      glm::color& attenuation, ray& scattered, sampler& gen) const override 
    {
        glm::vec3 reflected = glm::reflect(glm::normalize(r_in.direction()), rec.normal);
-       scattered = ray(rec.p, reflected + fuzz * random_unit_vector(), r_in.getTime());
+       glm::vec3 blur = fuzz * sample_uniform_sphere(gen.get_2d());
+       scattered = ray(rec.p, reflected + blur, r_in.getTime());
+       if (rec.has_differentials)
+       {
+           // the offset rays reflect about the normal where they meet the surface
+           scattered.set_differentials(
+               rec.p + rec.dpdx, glm::reflect(glm::normalize(r_in.rx_dir), glm::normalize(rec.normal + rec.dndx)) + blur,
+               rec.p + rec.dpdy, glm::reflect(glm::normalize(r_in.ry_dir), glm::normalize(rec.normal + rec.dndy)) + blur);
+       }
        attenuation = albedo;
        return (dot(scattered.direction(), rec.normal) > 0);
    }
@@ -132,7 +147,7 @@ public:
   dielectric(float index_of_refraction) : ir(index_of_refraction) {}
 
   virtual bool scatter(const ray& r_in, const hit_record& rec, 
-     glm::color& attenuation, ray& scattered) const override 
+     glm::color& attenuation, ray& scattered, sampler& gen) const override 
    {
       attenuation = glm::color(1.0, 1.0, 1.0);
       float refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
@@ -153,6 +168,28 @@ public:
           direction = r_out_perp + r_out_parallel;
       }
       scattered = ray(rec.p, direction, r_in.getTime());
+      if (rec.has_differentials)
+      {
+          // the offset rays bend like the ray itself, about the normal where they meet the surface
+          glm::vec3 nx = glm::normalize(rec.normal + rec.dndx);
+          glm::vec3 ny = glm::normalize(rec.normal + rec.dndy);
+          glm::vec3 dx = glm::normalize(r_in.rx_dir);
+          glm::vec3 dy = glm::normalize(r_in.ry_dir);
+          if (cannot_refract)
+          {
+              scattered.set_differentials(rec.p + rec.dpdx, glm::reflect(dx, nx), rec.p + rec.dpdy, glm::reflect(dy, ny));
+          }
+          else
+          {
+              // glm::refract() returns 0 for an offset ray that is totally reflected; drop them then
+              glm::vec3 x_direction = glm::refract(dx, nx, refraction_ratio);
+              glm::vec3 y_direction = glm::refract(dy, ny, refraction_ratio);
+              if (x_direction != glm::vec3(0) && y_direction != glm::vec3(0))
+              {
+                  scattered.set_differentials(rec.p + rec.dpdx, x_direction, rec.p + rec.dpdy, y_direction);
+              }
+          }
+      }
       return true;
    }
 
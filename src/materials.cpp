@@ -12,72 +12,22 @@
 #include "hittable_list.h"
 #include "texture.h"
 #include "moving_sphere.h"
+#include "scene.h"
+#include "sphere_set.h"
+#include "renderer.h"
+#include "light_list.h"
+#include "integrator.h"
+#include "wavefront.h"
+#include "packet_renderer.h"
 
 using namespace glm;
 using namespace agl;
 using namespace std;
 
-//this is the ray_color function for light source
-color ray_color_emit(const ray& r, const color& background, const hittable_list& world, int depth)
-{
-	hit_record rec;
-	if (depth <= 0)
-	{
-		return color(0);
-	}
-
-	if (!world.hit(r, 0.001f, infinity, rec))
-		return background;
-
-	ray scattered;
-	color attenuation;
-	color emitColor = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
-	if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-		return emitColor;
-	return emitColor + attenuation * ray_color_emit(scattered, background, world, depth - 1);
-}
-
-color ray_color(const ray& r, const hittable_list& world, int depth)
-{
-	hit_record rec;
-	if (depth <= 0)
-	{
-		return color(0);
-	}
-
-	if (world.hit(r, 0.001f, infinity, rec))
-	{
-		ray scattered;
-		color attenuation;
-		if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-		{
-			color recurseColor = ray_color(scattered, world, depth - 1);
-			return attenuation * recurseColor;
-		}
-		return attenuation;
-	}
-	vec3 unit_direction = normalize(r.direction());
-	auto t = 0.5f * (unit_direction.y + 1.0f);
-	return (1.0f - t) * color(1, 1, 1) + t * color(0.5f, 0.7f, 1.0f);
-}
-
-color normalize_color(const color& c, int samples_per_pixel)
-{
-	// todo: implement me!
-	float scale = 1.0f / samples_per_pixel;
-	float r = std::min(0.999f, std::max(0.0f, c.r * scale));
-	float g = std::min(0.999f, std::max(0.0f, c.g * scale));
-	float b = std::min(0.999f, std::max(0.0f, c.b * scale));
-
-	// apply gamma correction 
-	r = sqrt(r);
-	g = sqrt(g);
-	b = sqrt(b);
-
-	return color(r, g, b);
-}
-
-void ray_trace(ppm_image& image)
+// render one of the sample scenes, cases 0-6, and save it under the scene's name if
+// save is set; num_threads 0 => one per hardware core; wavefront => trace the sky-lit
+// cases in batches of paths, shading by material
+render_stats ray_trace_scene(ppm_image& image, int cases, int num_threads, bool wavefront, bool save)
 {
 	// Image
 	int height = image.height();
@@ -85,6 +35,16 @@ void ray_trace(ppm_image& image)
 	float aspect = width / float(height);
 	int samples_per_pixel = 10; // higher => more anti-aliasing
 	int max_depth = 10; // higher => less shadow acne
+	path_settings path(max_depth); // path length and russian roulette settings
+	bool adaptive = false; // true => stop sampling converged pixels and spend the budget on noisy ones
+	render_settings settings(samples_per_pixel);
+	settings.num_threads = num_threads;
+	if (adaptive)
+	{
+		settings.set_adaptive(8, 8 * samples_per_pixel, 0.01f);
+		settings.heatmap_file = "sample_heatmap.png";
+	}
+	bool packets = true; // true => trace camera rays in 8x8 packets (not with adaptive sampling)
 
 	// Camera
 	vec3 camera_pos(0, 0, 6);
@@ -92,152 +52,143 @@ void ray_trace(ppm_image& image)
 	float focal_length = 4.0;
 	camera cam(camera_pos, viewport_height, aspect, focal_length);
 	color background = color(0.0, 0.0, 0.0);
-	int cases = 6;
+	// ray differentials span this much of a pixel, as the samples of a pixel already
+	// average over it; textures are filtered over the footprint (see ray.h)
+	float footprint = std::max(0.125f, 1.0f / std::sqrt(float(samples_per_pixel)));
+
+	// render scene as seen from view with ray_color, one path at a time, in packets or as a wavefront
+	auto trace = [&](const scene& world, const camera& view) -> render_stats
+	{
+		auto camera_ray = [&](int i, int j, sampler& gen) -> ray
+		{
+			glm::vec2 jitter = gen.get_2d();
+			float u = float(i + jitter.x) / (width - 1);
+			float v = float(height - j - 1 - jitter.y) / (height - 1);
+			return view.get_ray_differential(u, v, footprint / (width - 1), footprint / (height - 1), gen);
+		};
+
+		if (wavefront)
+		{
+			return render_wavefront(image, settings, world, path, camera_ray);
+		}
+		if (packets && !settings.adaptive)
+		{
+			return render_packets(image, settings, world, camera_ray,
+				[&](const ray& r, bool hit, const hit_record& rec, sampler& gen) -> color
+			{
+				return ray_color(r, hit, rec, world, path, gen);
+			});
+		}
+		return render(image, settings, [&](int i, int j, sampler& gen) -> color
+		{
+			ray r = camera_ray(i, j, gen);
+			return ray_color(r, world, path, gen);
+		});
+	};
+
+	render_stats stats;
 	if (cases == 0)
 	{
+		scene world;
 		shared_ptr<texture> number_texture = make_shared<image_texture>("../images/numberGrid.png");
-		shared_ptr<material> number_surface = make_shared<lambertian>(number_texture);
-		shared_ptr<texture> wood_texture = make_shared<image_texture>("../images/wood.jpg");
-		shared_ptr<material> wood_surface = make_shared<lambertian>(wood_texture);
-		shared_ptr<material> gray = make_shared<lambertian>(color(0.5f));
+		uint32_t number_surface = world.add_material(make_shared<lambertian>(number_texture));
 		shared_ptr<texture> checker = make_shared<checker_texture>(color(0.945, 0.356, 0.356), color(0.964, 0.972, 0.407));
 
-		hittable_list world;
-		world.add(make_shared<sphere>(point3(0, 0, -1), 0.5f, number_surface));
-		world.add(make_shared<sphere>(point3(0, -100.5, -1), 100, make_shared<lambertian>(checker)));
-		world.add(make_shared<triangle>(point3(-2, 0, 0), point3(-1, 0, 1), point3(-2, 1, 1), make_shared<lambertian>(checker)));
+		world.add<sphere>(point3(0, 0, -1), 0.5f, number_surface);
+		world.add<sphere>(point3(0, -100.5, -1), 100, world.add_material(make_shared<lambertian>(checker)));
+		world.add<triangle>(point3(-2, 0, 0), point3(-1, 0, 1), point3(-2, 1, 1), world.add_material(make_shared<lambertian>(checker)));
 		// Ray trace
-		for (int j = 0; j < height; j++)
-		{
-			for (int i = 0; i < width; i++)
-			{
-				color c(0, 0, 0);
-				for (int s = 0; s < samples_per_pixel; s++) // antialias
-				{
-					float u = float(i + random_float()) / (width - 1);
-					float v = float(height - j - 1 - random_float()) / (height - 1);
+		world.build(0.0f, 1.0f);
+		stats = trace(world, cam);
 
-					ray r = cam.get_ray(u, v);
-					c += ray_color(r, world, max_depth);
-				}
-				c = normalize_color(c, samples_per_pixel);
-				image.set_vec3(j, i, c);
-			}
-		}
-
-		image.save("basic_checker_texture.png");
+		if (save) image.save("basic_checker_texture.png");
 	}
 	else if (cases == 1)
 	{
-		shared_ptr<material> gray = make_shared<lambertian>(color(0.5f));
-		shared_ptr<material> matteGreen = make_shared<lambertian>(color(0, 0.5f, 0));
-		shared_ptr<material> metalRed = make_shared<metal>(color(1, 0, 0), 0.3f);
-		shared_ptr<material> glass = make_shared<dielectric>(1.5f);
-		shared_ptr<material> phongDefault = make_shared<phong>(camera_pos);
+		scene world;
+		uint32_t gray = world.add_material(make_shared<lambertian>(color(0.5f)));
+		uint32_t metalRed = world.add_material(make_shared<metal>(color(1, 0, 0), 0.3f));
+		uint32_t glass = world.add_material(make_shared<dielectric>(1.5f));
+		uint32_t phongDefault = world.add_material(make_shared<phong>(camera_pos));
 		shared_ptr<texture> checker = make_shared<checker_texture>(color(0.945, 0.356, 0.356), color(0.294, 0.278, 0.941));
 
-		hittable_list world;
-		world.add(make_shared<sphere>(point3(-2.25, 0, -1), 0.5f, phongDefault));
-		world.add(make_shared<sphere>(point3(-0.75, 0, -1), 0.5f, glass));
-		world.add(make_shared<sphere>(point3(2.25, 0, -1), 0.5f, metalRed));
-		world.add(make_shared<sphere>(point3(0.75, 0, -1), 0.5f, make_shared<lambertian>(checker)));
-		world.add(make_shared<sphere>(point3(0, -100.5, -1), 100, gray));
+		world.add<sphere>(point3(-2.25, 0, -1), 0.5f, phongDefault);
+		world.add<sphere>(point3(-0.75, 0, -1), 0.5f, glass);
+		world.add<sphere>(point3(2.25, 0, -1), 0.5f, metalRed);
+		world.add<sphere>(point3(0.75, 0, -1), 0.5f, world.add_material(make_shared<lambertian>(checker)));
+		world.add<sphere>(point3(0, -100.5, -1), 100, gray);
 		// Ray trace
-		for (int j = 0; j < height; j++)
-		{
-			for (int i = 0; i < width; i++)
-			{
-				color c(0, 0, 0);
-				for (int s = 0; s < samples_per_pixel; s++) // antialias
-				{
-					float u = float(i + random_float()) / (width - 1);
-					float v = float(height - j - 1 - random_float()) / (height - 1);
-
-					ray r = cam.get_ray(u, v);
-					c += ray_color(r, world, max_depth);
-				}
-				c = normalize_color(c, samples_per_pixel);
-				image.set_vec3(j, i, c);
-			}
-		}
+		world.build(0.0f, 1.0f);
+		stats = trace(world, cam);
 
-		image.save("materials_check_texture.png");
+		if (save) image.save("materials_check_texture.png");
 	}
 	else if (cases == 2)
 	{
+		scene world;
 		shared_ptr<texture> earth_texture = make_shared<image_texture>("../images/earth.jpg");
-		shared_ptr<material> earth_surface = make_shared<lambertian>(earth_texture);
+		uint32_t earth_surface = world.add_material(make_shared<lambertian>(earth_texture));
 
-		hittable_list world;
-		world.add(make_shared<sphere>(point3(0, 0, -1), 1.3f, earth_surface));
+		world.add<sphere>(point3(0, 0, -1), 1.3f, earth_surface);
 		// Ray trace
-		for (int j = 0; j < height; j++)
-		{
-			for (int i = 0; i < width; i++)
-			{
-				color c(0, 0, 0);
-				for (int s = 0; s < samples_per_pixel; s++) // antialias
-				{
-					float u = float(i + random_float()) / (width - 1);
-					float v = float(height - j - 1 - random_float()) / (height - 1);
+		world.build(0.0f, 1.0f);
+		stats = trace(world, cam);
 
-					ray r = cam.get_ray(u, v);
-					c += ray_color(r, world, max_depth);
-				}
-				c = normalize_color(c, samples_per_pixel);
-				image.set_vec3(j, i, c);
-			}
-		}
-
-		image.save("image_texture.png");
+		if (save) image.save("image_texture.png");
 	}
 	else if (cases == 3)
 	{
+		scene world;
 		color background = color(0, 0, 0);
-		shared_ptr<material> gray = make_shared<lambertian>(color(0.5f));
 		shared_ptr<texture> checker = make_shared<checker_texture>(color(0.945, 0.356, 0.356), color(0.964, 0.972, 0.407));
-		shared_ptr<material> emitLight = make_shared<emit_light>(color(4, 4, 4));
+		uint32_t emitLight = world.add_material(make_shared<emit_light>(color(4, 4, 4)));
 
-		hittable_list world;
-		world.add(make_shared<sphere>(point3(2, 0, -1), 0.5f, emitLight));
-		world.add(make_shared<sphere>(point3(0, -100.5, -1), 100, make_shared<lambertian>(checker)));
-		world.add(make_shared<triangle>(point3(0, 0, 0), point3(-1, 0, 1), point3(1, 1, 1), emitLight));
-		//world.add(make_shared<plane>(point3(-2, 2, 0), vec3(0,0,1), emitLight));
+		world.add<sphere>(point3(2, 0, -1), 0.5f, emitLight);
+		world.add<sphere>(point3(0, -100.5, -1), 100, world.add_material(make_shared<lambertian>(checker)));
+		world.add<triangle>(point3(0, 0, 0), point3(-1, 0, 1), point3(1, 1, 1), emitLight);
+		//world.add<plane>(point3(-2, 2, 0), vec3(0,0,1), emitLight);
 
 
-		for (int j = 0; j < height; j++)
+		world.build(0.0f, 1.0f);
+		light_list lights(world);
+		auto camera_ray = [&](int i, int j, sampler& gen) -> ray
 		{
-			for (int i = 0; i < width; i++)
-			{
-				color c(0, 0, 0);
-				for (int s = 0; s < samples_per_pixel; s++) // antialias
-				{
-					float u = float(i + random_float()) / (width - 1);
-					float v = float(height - j - 1 - random_float()) / (height - 1);
+			glm::vec2 jitter = gen.get_2d();
+			float u = float(i + jitter.x) / (width - 1);
+			float v = float(height - j - 1 - jitter.y) / (height - 1);
+			return cam.get_ray_differential(u, v, footprint / (width - 1), footprint / (height - 1), gen);
+		};
 
-					ray r = cam.get_ray(u, v);
-					c += ray_color_emit(r, background, world, max_depth);
-				}
-				c = normalize_color(c, samples_per_pixel);
-				image.set_vec3(j, i, c);
-			}
+		if (packets && !settings.adaptive)
+		{
+			stats = render_packets(image, settings, world, camera_ray,
+				[&](const ray& r, bool hit, const hit_record& rec, sampler& gen) -> color
+			{
+				return ray_color_emit(r, hit, rec, background, world, lights, path, gen);
+			});
+		}
+		else
+		{
+			stats = render(image, settings, [&](int i, int j, sampler& gen) -> color
+			{
+				return ray_color_emit(camera_ray(i, j, gen), background, world, lights, path, gen);
+			});
 		}
 
-		image.save("light_sources.png");
+		if (save) image.save("light_sources.png");
 	}
 	else if (cases == 4)
 	{
-		hittable_list world;
-
-		shared_ptr<material> bottom = make_shared<lambertian>(color(0.5f));
-		shared_ptr<material> lambertian_yellow = make_shared<lambertian>(color(0.992, 0.949, 0.325));
-		shared_ptr<material> glass = make_shared<dielectric>(1.5);
-		shared_ptr<material> metal_red = make_shared<metal>(color(1, 0, 0), 0.3f);
-
-		world.add(make_shared<sphere>(point3(0.0, -100.5, -1.0), 100.0, bottom));
-		world.add(make_shared<sphere>(point3(0.0, 0.0, -1.0), 0.5, lambertian_yellow));
-		world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.5, glass));
-		world.add(make_shared<sphere>(point3(1.0, 0.0, -1.0), 0.5, metal_red));
+		scene world;
+		uint32_t bottom = world.add_material(make_shared<lambertian>(color(0.5f)));
+		uint32_t lambertian_yellow = world.add_material(make_shared<lambertian>(color(0.992, 0.949, 0.325)));
+		uint32_t glass = world.add_material(make_shared<dielectric>(1.5));
+		uint32_t metal_red = world.add_material(make_shared<metal>(color(1, 0, 0), 0.3f));
+
+		world.add<sphere>(point3(0.0, -100.5, -1.0), 100.0, bottom);
+		world.add<sphere>(point3(0.0, 0.0, -1.0), 0.5, lambertian_yellow);
+		world.add<sphere>(point3(-1.0, 0.0, -1.0), 0.5, glass);
+		world.add<sphere>(point3(1.0, 0.0, -1.0), 0.5, metal_red);
 		point3 lookfrom(-3, 3, 2);
 		point3 lookat(0, 0, -1);
 		vec3 vup(0, 1, 0);
@@ -245,129 +196,83 @@ void ray_trace(ppm_image& image)
 		float aperture = 2.0;
 
 		camera cam1(lookfrom, lookat, vup, 20, aspect, aperture, dist_to_focus);
-		for (int j = 0; j < height; j++)
-		{
-			for (int i = 0; i < width; i++)
-			{
-				color c(0, 0, 0);
-				for (int s = 0; s < samples_per_pixel; s++) // antialias
-				{
-					float u = float(i + random_float()) / (width - 1);
-					float v = float(height - j - 1 - random_float()) / (height - 1);
-
-					ray r = cam1.get_ray(u, v);
-					c += ray_color(r, world, max_depth);
-				}
-				c = normalize_color(c, samples_per_pixel);
-				image.set_vec3(j, i, c);
-			}
-		}
+		world.build(0.0f, 1.0f);
+		stats = trace(world, cam1);
 
-		image.save("defocus_blur.png");
+		if (save) image.save("defocus_blur.png");
 	}
 	else if (cases == 5)
 	{
-		hittable_list world;
-
-		shared_ptr<material> bottom = make_shared<lambertian>(color(0.5f));
-		shared_ptr<material> lambertian_red = make_shared<lambertian>(color(0.898, 0.243, 0.243));
-		shared_ptr<material> lambertian_blue = make_shared<lambertian>(color(0.2, 0.435, 0.858));
+		scene world;
+		uint32_t bottom = world.add_material(make_shared<lambertian>(color(0.5f)));
+		uint32_t lambertian_red = world.add_material(make_shared<lambertian>(color(0.898, 0.243, 0.243)));
+		uint32_t lambertian_blue = world.add_material(make_shared<lambertian>(color(0.2, 0.435, 0.858)));
 
 		point3 center1(0.2, 0.2, 0.2);
 		point3 center2(2, 0.5, 0.9);
 		point3 center3(-2, 0.5, 0.9);
 		point3 center4(-1, 0.5, 0.9);
-		world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, bottom));
-		world.add(make_shared<moving_sphere>(center1, point3(0, random_float(0, 0.5), 0) + center1, 0.0, 1.0, 0.2, lambertian_red));
-		world.add(make_shared<moving_sphere>(center2, point3(random_float(0, 0.5), 0, 0) + center2, 0.0, 1.0, 0.2, lambertian_blue));
-		world.add(make_shared<moving_sphere>(center3, point3(0, random_float(0, 0.5), 0) + center3, 0.0, 1.0, 0.2, lambertian_blue));
-		world.add(make_shared<moving_sphere>(center4, point3(0, random_float(0, 0.5), 0) + center4, 0.0, 1.0, 0.2, lambertian_red));
+		world.add<sphere>(point3(0, -1000, 0), 1000, bottom);
+		world.add<moving_sphere>(center1, point3(0, random_float(0, 0.5), 0) + center1, 0.0, 1.0, 0.2, lambertian_red);
+		world.add<moving_sphere>(center2, point3(random_float(0, 0.5), 0, 0) + center2, 0.0, 1.0, 0.2, lambertian_blue);
+		world.add<moving_sphere>(center3, point3(0, random_float(0, 0.5), 0) + center3, 0.0, 1.0, 0.2, lambertian_blue);
+		world.add<moving_sphere>(center4, point3(0, random_float(0, 0.5), 0) + center4, 0.0, 1.0, 0.2, lambertian_red);
 
-		point3 lookfrom(13, 3, 2);
-		point3 lookat(0, 0, -1);
-		vec3 vup(0, 1, 0);
-		float dist_to_focus = length(lookfrom - lookat);
-		float aperture = 2.0;
-
-		camera cam1(lookfrom, lookat, vup, 20, aspect, aperture, dist_to_focus);
-		for (int j = 0; j < height; j++)
-		{
-			for (int i = 0; i < width; i++)
-			{
-				color c(0, 0, 0);
-				for (int s = 0; s < samples_per_pixel; s++) // antialias
-				{
-					float u = float(i + random_float()) / (width - 1);
-					float v = float(height - j - 1 - random_float()) / (height - 1);
+		camera motion_cam(camera_pos, viewport_height, aspect, focal_length, 0.0f, 1.0f); // shutter open over [0, 1]
+		world.build(0.0f, 1.0f);
+		stats = trace(world, motion_cam);
 
-					ray r = cam.get_ray(u, v);
-					c += ray_color(r, world, max_depth);
-				}
-				c = normalize_color(c, samples_per_pixel);
-				image.set_vec3(j, i, c);
-			}
-		}
-
-		image.save("motion_blur.png");
+		if (save) image.save("motion_blur.png");
 	}
 	else if (cases == 6)
 	{
+		scene world;
 		vec3 camera_pos(0, 0, 15);
 		float viewport_height = 2.0f;
 		float focal_length = 4.0;
 		camera cam2(camera_pos, viewport_height, aspect, focal_length);
-		hittable_list world;
-
-		shared_ptr<material> bottom = make_shared<lambertian>(color(0.5f));
+		uint32_t bottom = world.add_material(make_shared<lambertian>(color(0.5f)));
 		shared_ptr<texture> sun_texture = make_shared<image_texture>("../images/sun.jpg");
-		shared_ptr<material> sun_surface = make_shared<lambertian>(sun_texture);
+		uint32_t sun_surface = world.add_material(make_shared<lambertian>(sun_texture));
 		shared_ptr<texture> mercury_texture = make_shared<image_texture>("../images/mercury.jpg");
-		shared_ptr<material> mercury_surface = make_shared<lambertian>(mercury_texture);
+		uint32_t mercury_surface = world.add_material(make_shared<lambertian>(mercury_texture));
 		shared_ptr<texture> venus_texture = make_shared<image_texture>("../images/venus.jpg");
-		shared_ptr<material> venus_surface = make_shared<lambertian>(venus_texture);
+		uint32_t venus_surface = world.add_material(make_shared<lambertian>(venus_texture));
 		shared_ptr<texture> earth_texture = make_shared<image_texture>("../images/earth.jpg");
-		shared_ptr<material> earth_surface = make_shared<lambertian>(earth_texture);
+		uint32_t earth_surface = world.add_material(make_shared<lambertian>(earth_texture));
 		shared_ptr<texture> mars_texture = make_shared<image_texture>("../images/mars.jpg");
-		shared_ptr<material> mars_surface = make_shared<lambertian>(mars_texture);
+		uint32_t mars_surface = world.add_material(make_shared<lambertian>(mars_texture));
 		shared_ptr<texture> jupiter_texture = make_shared<image_texture>("../images/jupiter.jpg");
-		shared_ptr<material> jupiter_surface = make_shared<lambertian>(jupiter_texture);
+		uint32_t jupiter_surface = world.add_material(make_shared<lambertian>(jupiter_texture));
 		shared_ptr<texture> saturn_texture = make_shared<image_texture>("../images/Saturn.jpg");
-		shared_ptr<material> saturn_surface = make_shared<lambertian>(saturn_texture);
+		uint32_t saturn_surface = world.add_material(make_shared<lambertian>(saturn_texture));
 		shared_ptr<texture> uranus_texture = make_shared<image_texture>("../images/uranus.jpg");
-		shared_ptr<material> uranus_surface = make_shared<lambertian>(uranus_texture);
+		uint32_t uranus_surface = world.add_material(make_shared<lambertian>(uranus_texture));
 		shared_ptr<texture> naptune_texture = make_shared<image_texture>("../images/naptune.jpg");
-		shared_ptr<material> naptune_surface = make_shared<lambertian>(naptune_texture);
-
-		world.add(make_shared<sphere>(point3(0, -1000, 0), 995, bottom));
-		world.add(make_shared<sphere>(point3(-6.5, 0, 0), 3.0f, sun_surface));
-		world.add(make_shared<sphere>(point3(-3, 0,  0), 0.1f, mercury_surface));
-		world.add(make_shared<sphere>(point3(-2.5, 0, 0), 0.2f, venus_surface));
-		world.add(make_shared<sphere>(point3(-1.75, 0, 0), 0.4f, earth_surface));
-		world.add(make_shared<sphere>(point3(-1, 0, 0), 0.2f, mars_surface));
-		world.add(make_shared<sphere>(point3(0.5, 0, 0), 1.0f, jupiter_surface));
-		world.add(make_shared<sphere>(point3(2.5, 0, 0), 0.85f, saturn_surface));
-		world.add(make_shared<sphere>(point3(4, 0, 0), 0.4f, uranus_surface));
-		world.add(make_shared<sphere>(point3(5, 0, 0), 0.4f, naptune_surface));
-
-		for (int j = 0; j < height; j++)
-		{
-			for (int i = 0; i < width; i++)
-			{
-				color c(0, 0, 0);
-				for (int s = 0; s < samples_per_pixel; s++) // antialias
-				{
-					float u = float(i + random_float()) / (width - 1);
-					float v = float(height - j - 1 - random_float()) / (height - 1);
-
-					ray r = cam2.get_ray(u, v);
-					c += ray_color(r, world, max_depth);
-				}
-				c = normalize_color(c, samples_per_pixel);
-				image.set_vec3(j, i, c);
-			}
-		}
-
-		image.save("solar_system.png");
+		uint32_t naptune_surface = world.add_material(make_shared<lambertian>(naptune_texture));
+
+		world.add<sphere>(point3(0, -1000, 0), 995, bottom);
+		// the planets are tested together, several spheres per instruction
+		sphere_set* planets = world.add<sphere_set>();
+		planets->add(point3(-6.5, 0, 0), 3.0f, sun_surface);
+		planets->add(point3(-3, 0,  0), 0.1f, mercury_surface);
+		planets->add(point3(-2.5, 0, 0), 0.2f, venus_surface);
+		planets->add(point3(-1.75, 0, 0), 0.4f, earth_surface);
+		planets->add(point3(-1, 0, 0), 0.2f, mars_surface);
+		planets->add(point3(0.5, 0, 0), 1.0f, jupiter_surface);
+		planets->add(point3(2.5, 0, 0), 0.85f, saturn_surface);
+		planets->add(point3(4, 0, 0), 0.4f, uranus_surface);
+		planets->add(point3(5, 0, 0), 0.4f, naptune_surface);
+
+		world.build(0.0f, 1.0f);
+		stats = trace(world, cam2);
+
+		if (save) image.save("solar_system.png");
 	}
+	return stats;
+}
 
+void ray_trace(ppm_image& image)
+{
+	ray_trace_scene(image, 6, 0, false, true);
 }
@@ -0,0 +1,466 @@
+// mipmap.h
+// Texel storage for image_texture: the image and a chain of half-size copies of
+// it (a mip chain), down to 1x1. Each level is stored in 4x4 tiles of texels,
+// with the texels of a tile in Morton (Z) order. A bilinear lookup reads a 2x2
+// block of texels, which almost always lies in one or two tiles, where a
+// row-major image puts every row of the block in a different cache line.
+//
+// A minified texture is read from the level whose texels are about the size of
+// the lookup's footprint, so that nearby lookups read nearby texels and the
+// result is the average of the texels under the footprint rather than one of
+// them picked at random (aliasing).
+//
+// Texels are stored in one of several formats (texel_format), decoded on every
+// read. Smaller texels keep more of a texture set in cache and memory:
+//   unorm8  4 bytes, 8 bits per channel read as value / 255; a tile is one cache line
+//   srgb8   4 bytes, 8 bits per channel on the sRGB curve, read through a table
+//   half    8 bytes, a 16-bit float per channel, for HDR images
+//   bc1     half a byte: each tile is one 8-byte block of two RGB565 colors and a
+//           2-bit choice per texel among them and two colors in between (BC1 style)
+
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "AGLM.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+enum class texel_format { unorm8, srgb8, half, bc1 };
+
+class mipmap {
+public:
+   mipmap() : format(texel_format::unorm8), base(0) {}
+
+   // build the chain from 8-bit pixels with the given number of channels (3 or 4;
+   // alpha is dropped), row-major from the top row; srgb8 reads them as sRGB,
+   // the other formats as value / 255
+   mipmap(const unsigned char* pixels, int width, int height, int channels = 3,
+      texel_format format = texel_format::unorm8);
+
+   // the same from linear floating point pixels, e.g. an HDR image
+   mipmap(const float* pixels, int width, int height, int channels = 3,
+      texel_format format = texel_format::half);
+
+   bool empty() const { return levels.empty(); }
+   int width() const { return empty() ? 0 : levels[0].width; }
+   int height() const { return empty() ? 0 : levels[0].height; }
+   int num_levels() const { return (int) levels.size(); }
+   texel_format storage_format() const { return format; }
+
+   // bytes used by the texels of all levels
+   size_t memory_bytes() const { return storage.capacity() * sizeof(uint32_t); }
+
+   // texel (x, y) of a level, clamped to its edges
+   glm::color texel(int level, int x, int y) const;
+
+   // bilinear lookup at (s, t) in [0, 1]^2, t = 0 at the top row
+   glm::color bilinear(int level, float s, float t) const;
+
+   // Trilinear lookup: bilinear in the two levels around the size of the footprint,
+   // given by the derivatives of (s, t) across a pixel, blended by where the footprint
+   // falls between them. Zero derivatives give a bilinear lookup in the full image.
+   glm::color trilinear(float s, float t, const glm::vec2& dstdx, const glm::vec2& dstdy) const;
+
+   // the level, with a fraction, whose texels match the footprint of trilinear()
+   float level_of_detail(const glm::vec2& dstdx, const glm::vec2& dstdy) const {
+      glm::vec2 size((float) width(), (float) height());
+      float footprint = std::max(glm::length(dstdx * size), glm::length(dstdy * size));
+      if (!(footprint > 1.0f)) return 0.0f;
+      return std::min(std::log2(footprint), float(num_levels() - 1));
+   }
+
+private:
+   struct level_info {
+      int width, height;
+      int tiles_x; // tiles per row
+      size_t offset; // index of the level's first word in storage, after base
+   };
+
+   static const int tile_size = 4;
+
+   // Where texel (x, y) is within its level: the tile, whole tiles in rows, and the
+   // Morton index in the tile. The texel formats below turn this into words of storage.
+   static size_t tile_of(const level_info& l, uint32_t x, uint32_t y) {
+      return (size_t) (y >> 2) * l.tiles_x + (x >> 2);
+   }
+   static uint32_t in_tile(uint32_t x, uint32_t y) {
+      return (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2);
+   }
+
+   // Each format reads texel k of the tile at tile, and encodes a 4x4 tile of
+   // linear colors (in Morton order) into its words.
+   struct unorm8_texels {
+      static const int tile_words = 16;
+      static glm::color read(const uint32_t* tile, uint32_t k) { return unpack(tile[k]); }
+      static void encode(const glm::color* colors, uint32_t* tile) {
+         for (int k = 0; k < 16; k++) tile[k] = pack(colors[k], &to_unorm8);
+      }
+   };
+
+   struct srgb8_texels {
+      static const int tile_words = 16;
+      static glm::color read(const uint32_t* tile, uint32_t k) {
+         const float* table = srgb_table();
+         uint32_t texel = tile[k];
+         return glm::color(table[texel & 0xff], table[(texel >> 8) & 0xff], table[(texel >> 16) & 0xff]);
+      }
+      static void encode(const glm::color* colors, uint32_t* tile) {
+         for (int k = 0; k < 16; k++) tile[k] = pack(colors[k], &to_srgb8);
+      }
+   };
+
+   struct half_texels {
+      static const int tile_words = 32;
+      static glm::color read(const uint32_t* tile, uint32_t k) {
+         uint32_t rg = tile[2 * k], b = tile[2 * k + 1];
+         return glm::color(from_half(rg & 0xffff), from_half(rg >> 16), from_half(b & 0xffff));
+      }
+      static void encode(const glm::color* colors, uint32_t* tile) {
+         for (int k = 0; k < 16; k++)
+         {
+            tile[2 * k] = to_half(colors[k].r) | ((uint32_t) to_half(colors[k].g) << 16);
+            tile[2 * k + 1] = to_half(colors[k].b);
+         }
+      }
+   };
+
+   struct bc1_texels {
+      static const int tile_words = 2;
+      static glm::color read(const uint32_t* tile, uint32_t k) {
+         glm::color c0 = from_rgb565(tile[0] & 0xffff);
+         glm::color c1 = from_rgb565(tile[0] >> 16);
+         float weight = float((tile[1] >> (2 * k)) & 3) * (1.0f / 3.0f);
+         return c0 + weight * (c1 - c0);
+      }
+      static void encode(const glm::color* colors, uint32_t* tile);
+   };
+
+   template <class Texels>
+   glm::color texel_in(const level_info& l, int x, int y) const {
+      const uint32_t* words = &storage[base + l.offset];
+      return Texels::read(words + tile_of(l, x, y) * Texels::tile_words, in_tile(x, y));
+   }
+
+   template <class Texels>
+   glm::color bilinear_in(const level_info& l, float s, float t) const;
+
+   template <class Texels>
+   void encode_level(const level_info& l, const std::vector<glm::color>& colors);
+
+   void build(std::vector<glm::color> colors, int width, int height);
+
+   static uint32_t pack(const glm::color& c, unsigned char (*to_byte)(float)) {
+      return (uint32_t) to_byte(c.r) | ((uint32_t) to_byte(c.g) << 8) | ((uint32_t) to_byte(c.b) << 16);
+   }
+
+   static glm::color unpack(uint32_t texel) {
+      const float scale = 1.0f / 255.0f;
+      return scale * glm::color(float(texel & 0xff), float((texel >> 8) & 0xff), float((texel >> 16) & 0xff));
+   }
+
+   static unsigned char to_unorm8(float x) {
+      return (unsigned char) std::min(std::max(x * 255.0f + 0.5f, 0.0f), 255.0f);
+   }
+
+   static float srgb_to_linear(float x) {
+      return x <= 0.04045f ? x / 12.92f : std::pow((x + 0.055f) / 1.055f, 2.4f);
+   }
+
+   static unsigned char to_srgb8(float x) {
+      x = std::min(std::max(x, 0.0f), 1.0f);
+      return to_unorm8(x <= 0.0031308f ? 12.92f * x : 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f);
+   }
+
+   // linear value of each 8-bit sRGB value
+   static const float* srgb_table() {
+      struct table {
+         table() { for (int k = 0; k < 256; k++) values[k] = srgb_to_linear(k / 255.0f); }
+         float values[256];
+      };
+      static const table srgb;
+      return srgb.values;
+   }
+
+   // 16-bit floats, without relying on hardware conversions; values past the
+   // largest half (65504) are clamped to it
+   static float from_half(uint32_t h) {
+      // move the exponent and mantissa into place, then rebias the exponent by
+      // scaling with 2^112; this also handles subnormal halves
+      uint32_t bits = (h & 0x7fff) << 13;
+      float magnitude;
+      std::memcpy(&magnitude, &bits, sizeof(float));
+      magnitude *= 5.192296858534828e+33f; // 2^112
+      return (h & 0x8000) ? -magnitude : magnitude;
+   }
+
+   static uint32_t to_half(float f) {
+      uint32_t x;
+      std::memcpy(&x, &f, sizeof(float));
+      uint32_t sign = (x >> 16) & 0x8000;
+      x &= 0x7fffffff;
+      if (x >= 0x477ff000) return sign | 0x7bff; // rounds to 65520 or more
+      if (x < 0x38800000) // below the smallest normal half, 2^-14
+      {
+         float magnitude;
+         std::memcpy(&magnitude, &x, sizeof(float));
+         return sign | (uint32_t) std::lround(magnitude * 16777216.0f); // multiples of 2^-24
+      }
+      x -= 0x38000000; // rebias the exponent from 127 to 15
+      return sign | ((x + 0x0fff + ((x >> 13) & 1)) >> 13); // round to nearest even
+   }
+
+   static glm::color from_rgb565(uint32_t c) {
+      return glm::color(float(c >> 11) * (1.0f / 31.0f), float((c >> 5) & 63) * (1.0f / 63.0f), float(c & 31) * (1.0f / 31.0f));
+   }
+
+   static uint32_t to_rgb565(const glm::color& c) {
+      glm::color clamped = glm::clamp(c, glm::color(0.0f), glm::color(1.0f));
+      return ((uint32_t) (clamped.r * 31.0f + 0.5f) << 11) | ((uint32_t) (clamped.g * 63.0f + 0.5f) << 5) |
+         (uint32_t) (clamped.b * 31.0f + 0.5f);
+   }
+
+   texel_format format;
+   std::vector<level_info> levels;
+   std::vector<uint32_t> storage;
+   size_t base; // first word of storage on a 64-byte boundary, so that tiles do not straddle cache lines
+};
+
+inline mipmap::mipmap(const unsigned char* pixels, int width, int height, int channels, texel_format format)
+   : format(format), base(0)
+{
+   if (!pixels || width <= 0 || height <= 0) return;
+
+   std::vector<glm::color> colors((size_t) width * height);
+   const float* table = srgb_table();
+   for (size_t k = 0; k < colors.size(); k++)
+   {
+      const unsigned char* p = pixels + k * channels;
+      colors[k] = format == texel_format::srgb8 ? glm::color(table[p[0]], table[p[1]], table[p[2]]) :
+         (1.0f / 255.0f) * glm::color(float(p[0]), float(p[1]), float(p[2]));
+   }
+   build(std::move(colors), width, height);
+}
+
+inline mipmap::mipmap(const float* pixels, int width, int height, int channels, texel_format format)
+   : format(format), base(0)
+{
+   if (!pixels || width <= 0 || height <= 0) return;
+
+   std::vector<glm::color> colors((size_t) width * height);
+   for (size_t k = 0; k < colors.size(); k++)
+   {
+      const float* p = pixels + k * channels;
+      colors[k] = glm::color(p[0], p[1], p[2]);
+   }
+   build(std::move(colors), width, height);
+}
+
+// colors is the full image in linear values, row-major from the top row
+inline void mipmap::build(std::vector<glm::color> colors, int width, int height)
+{
+   int tile_words = 0;
+   switch (format)
+   {
+   case texel_format::unorm8: tile_words = unorm8_texels::tile_words; break;
+   case texel_format::srgb8: tile_words = srgb8_texels::tile_words; break;
+   case texel_format::half: tile_words = half_texels::tile_words; break;
+   case texel_format::bc1: tile_words = bc1_texels::tile_words; break;
+   }
+
+   // lay out the levels, each a whole number of tiles
+   size_t total = 0;
+   int w = width, h = height;
+   while (true)
+   {
+      level_info l;
+      l.width = w;
+      l.height = h;
+      l.tiles_x = (w + tile_size - 1) / tile_size;
+      l.offset = total;
+      levels.push_back(l);
+      total += (size_t) l.tiles_x * ((h + tile_size - 1) / tile_size) * tile_words;
+      if (w == 1 && h == 1) break;
+      w = std::max(1, w / 2);
+      h = std::max(1, h / 2);
+   }
+
+   const size_t line_words = 64 / sizeof(uint32_t);
+   storage.assign(total + line_words - 1, 0);
+   base = (line_words - (reinterpret_cast<uintptr_t>(storage.data()) / sizeof(uint32_t)) % line_words) % line_words;
+
+   for (size_t k = 0; k < levels.size(); k++)
+   {
+      const level_info& l = levels[k];
+      if (k > 0)
+      {
+         // each texel of a level is the average of 2x2 texels of the one above it,
+         // in linear values before they are encoded; odd sizes drop the last row or column
+         const level_info& above = levels[k - 1];
+         std::vector<glm::color> half_size((size_t) l.width * l.height);
+         for (int y = 0; y < l.height; y++)
+         {
+            for (int x = 0; x < l.width; x++)
+            {
+               int x0 = std::min(2 * x, above.width - 1), x1 = std::min(2 * x + 1, above.width - 1);
+               int y0 = std::min(2 * y, above.height - 1), y1 = std::min(2 * y + 1, above.height - 1);
+               half_size[(size_t) y * l.width + x] = 0.25f * (colors[(size_t) y0 * above.width + x0] +
+                  colors[(size_t) y0 * above.width + x1] + colors[(size_t) y1 * above.width + x0] +
+                  colors[(size_t) y1 * above.width + x1]);
+            }
+         }
+         colors.swap(half_size);
+      }
+
+      switch (format)
+      {
+      case texel_format::unorm8: encode_level<unorm8_texels>(l, colors); break;
+      case texel_format::srgb8: encode_level<srgb8_texels>(l, colors); break;
+      case texel_format::half: encode_level<half_texels>(l, colors); break;
+      case texel_format::bc1: encode_level<bc1_texels>(l, colors); break;
+      }
+   }
+}
+
+template <class Texels>
+inline void mipmap::encode_level(const level_info& l, const std::vector<glm::color>& colors)
+{
+   uint32_t* words = &storage[base + l.offset];
+   int tiles_y = (l.height + tile_size - 1) / tile_size;
+   for (int ty = 0; ty < tiles_y; ty++)
+   {
+      for (int tx = 0; tx < l.tiles_x; tx++)
+      {
+         // the texels of the tile in Morton order; past the edges of the level, repeat them
+         glm::color tile[16];
+         for (uint32_t k = 0; k < 16; k++)
+         {
+            int x = std::min(tx * tile_size + int((k & 1) | ((k >> 1) & 2)), l.width - 1);
+            int y = std::min(ty * tile_size + int(((k >> 1) & 1) | ((k >> 2) & 2)), l.height - 1);
+            tile[k] = colors[(size_t) y * l.width + x];
+         }
+         Texels::encode(tile, words + ((size_t) ty * l.tiles_x + tx) * Texels::tile_words);
+      }
+   }
+}
+
+// Endpoints at the extremes of the tile's colors along their principal axis; each
+// texel then takes the closest of the four colors of the block.
+inline void mipmap::bc1_texels::encode(const glm::color* colors, uint32_t* tile)
+{
+   glm::color mean(0.0f);
+   for (int k = 0; k < 16; k++) mean += colors[k];
+   mean *= 1.0f / 16.0f;
+
+   // principal axis of the covariance, by power iteration
+   glm::mat3 covariance(0.0f);
+   for (int k = 0; k < 16; k++)
+   {
+      glm::vec3 d = colors[k] - mean;
+      covariance += glm::outerProduct(d, d);
+   }
+   glm::vec3 axis(1.0f);
+   for (int iteration = 0; iteration < 4; iteration++)
+   {
+      glm::vec3 next = covariance * axis;
+      float length = glm::length(next);
+      if (length < 1e-12f) break;
+      axis = next / length;
+   }
+
+   float lo = 0.0f, hi = 0.0f;
+   for (int k = 0; k < 16; k++)
+   {
+      float along = glm::dot(colors[k] - mean, axis);
+      lo = std::min(lo, along);
+      hi = std::max(hi, along);
+   }
+   uint32_t e0 = to_rgb565(mean + lo * axis);
+   uint32_t e1 = to_rgb565(mean + hi * axis);
+   tile[0] = e0 | (e1 << 16);
+
+   glm::color palette[4];
+   for (int i = 0; i < 4; i++) palette[i] = from_rgb565(e0) + (i / 3.0f) * (from_rgb565(e1) - from_rgb565(e0));
+   uint32_t indices = 0;
+   for (int k = 0; k < 16; k++)
+   {
+      int best = 0;
+      float best_distance = glm::dot(colors[k] - palette[0], colors[k] - palette[0]);
+      for (int i = 1; i < 4; i++)
+      {
+         float distance = glm::dot(colors[k] - palette[i], colors[k] - palette[i]);
+         if (distance < best_distance)
+         {
+            best = i;
+            best_distance = distance;
+         }
+      }
+      indices |= (uint32_t) best << (2 * k);
+   }
+   tile[1] = indices;
+}
+
+inline glm::color mipmap::texel(int level, int x, int y) const
+{
+   const level_info& l = levels[level];
+   x = std::min(std::max(x, 0), l.width - 1);
+   y = std::min(std::max(y, 0), l.height - 1);
+   switch (format)
+   {
+   case texel_format::srgb8: return texel_in<srgb8_texels>(l, x, y);
+   case texel_format::half: return texel_in<half_texels>(l, x, y);
+   case texel_format::bc1: return texel_in<bc1_texels>(l, x, y);
+   default: return texel_in<unorm8_texels>(l, x, y);
+   }
+}
+
+template <class Texels>
+inline glm::color mipmap::bilinear_in(const level_info& l, float s, float t) const
+{
+   // texel centers are at half-integer coordinates
+   float x = s * l.width - 0.5f;
+   float y = t * l.height - 0.5f;
+   float x_floor = std::floor(x);
+   float y_floor = std::floor(y);
+   float fx = x - x_floor;
+   float fy = y - y_floor;
+   int x0 = (int) x_floor;
+   int y0 = (int) y_floor;
+
+   // clamp to the edges
+   int x1 = std::min(std::max(x0 + 1, 0), l.width - 1);
+   int y1 = std::min(std::max(y0 + 1, 0), l.height - 1);
+   x0 = std::min(std::max(x0, 0), l.width - 1);
+   y0 = std::min(std::max(y0, 0), l.height - 1);
+
+   float w00 = (1.0f - fx) * (1.0f - fy), w10 = fx * (1.0f - fy), w01 = (1.0f - fx) * fy, w11 = fx * fy;
+   return w00 * texel_in<Texels>(l, x0, y0) + w10 * texel_in<Texels>(l, x1, y0) +
+      w01 * texel_in<Texels>(l, x0, y1) + w11 * texel_in<Texels>(l, x1, y1);
+}
+
+inline glm::color mipmap::bilinear(int level, float s, float t) const
+{
+   const level_info& l = levels[level];
+   switch (format)
+   {
+   case texel_format::srgb8: return bilinear_in<srgb8_texels>(l, s, t);
+   case texel_format::half: return bilinear_in<half_texels>(l, s, t);
+   case texel_format::bc1: return bilinear_in<bc1_texels>(l, s, t);
+   default: return bilinear_in<unorm8_texels>(l, s, t);
+   }
+}
+
+inline glm::color mipmap::trilinear(float s, float t, const glm::vec2& dstdx, const glm::vec2& dstdy) const
+{
+   float lod = level_of_detail(dstdx, dstdy);
+   int level = (int) lod;
+   float fraction = lod - level;
+   if (fraction == 0.0f || level + 1 >= num_levels()) return bilinear(level, s, t);
+   return glm::mix(bilinear(level, s, t), bilinear(level + 1, s, t), fraction);
+}
+
+#endif
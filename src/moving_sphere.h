@@ -9,17 +9,19 @@
 class moving_sphere : public hittable {
 public:
     moving_sphere() {}
-    moving_sphere(glm::point3 cen0, glm::point3 cen1, double _time0, double _time1, double r, std::shared_ptr<material> m)
-        : center0(cen0), center1(cen1), time0(_time0), time1(_time1), radius(r), mat_ptr(m)
+    moving_sphere(glm::point3 cen0, glm::point3 cen1, double _time0, double _time1, double r, uint32_t m)
+        : center0(cen0), center1(cen1), time0(_time0), time1(_time1), radius(r), mat_id(m)
     {};
 
-    virtual bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const override;
+    virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override;
+    virtual void finalize_hit(const ray& r, hit_record& rec) const override;
+    virtual bool bounding_box(float _time0, float _time1, aabb& output_box) const override;
     glm::point3 center(float time) const;
 
 public:
    glm::point3 center0, center1;
    float radius, time0, time1;
-   std::shared_ptr<material> mat_ptr;
+   uint32_t mat_id; // index into the scene's material_table
 
 private:
     static void get_uv_coordinates(const glm::point3& p, float& u, float& v) {
@@ -31,11 +33,11 @@ private:
     }
 };
 
-glm::point3 moving_sphere::center(float time) const {
+inline glm::point3 moving_sphere::center(float time) const {
     return center0 + ((time - time0) / (time1 - time0)) * (center1 - center0);
 }
 
-bool moving_sphere::hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
+inline bool moving_sphere::intersect(const ray& r, float t_min, float t_max, hit_record& rec) const {
     glm::vec3 oc = r.origin() - center(r.getTime());
     float a = glm::dot(r.direction(), r.direction());
     float half_b = glm::dot(oc, r.direction());
@@ -54,13 +56,26 @@ bool moving_sphere::hit(const ray& r, float t_min, float t_max, hit_record& rec)
     
        // save relevant data in hit record
     rec.t = t; // save the time when we hit the object
-    rec.p = r.at(t); // ray.origin + t * ray.direction
-    rec.mat_ptr = mat_ptr; 
+    rec.mat_id = mat_id; 
+    rec.object = this;
+    return true;
+}
+
+inline void moving_sphere::finalize_hit(const ray& r, hit_record& rec) const {
+    rec.p = r.at(rec.t); // ray.origin + t * ray.direction
     
        // save normal
     glm::vec3 outward_normal = normalize(rec.p - center(r.getTime())); // compute unit length normal
     rec.set_face_normal(r, outward_normal);
-    
+    get_uv_coordinates(outward_normal, rec.u, rec.v);
+}
+
+inline bool moving_sphere::bounding_box(float _time0, float _time1, aabb& output_box) const {
+    // bound the whole swept volume between the two shutter times
+    glm::vec3 extent(fabs(radius));
+    aabb box0(center(_time0) - extent, center(_time0) + extent);
+    aabb box1(center(_time1) - extent, center(_time1) + extent);
+    output_box = surrounding_box(box0, box1);
     return true;
 }
 
@@ -0,0 +1,278 @@
+// obj_loader.h
+// Loads the triangles of a Wavefront OBJ file into a triangle_mesh. The file is
+// read in large blocks and parsed in place, without a stream or a string per
+// line. Supports v, vt, vn and f records (with v, v/vt, v//vn and v/vt/vn corners,
+// and negative indices); polygons are split into triangle fans. Other records,
+// such as groups and materials, are skipped.
+//
+// Each distinct position/uv/normal combination used by a face becomes one vertex
+// of the mesh, so the mesh needs a single index per corner.
+
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "triangle_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// one corner of a face: indices into the file's v, vt and vn lists, -1 if absent
+struct obj_corner {
+   int32_t v, vt, vn;
+
+   bool operator==(const obj_corner& other) const {
+      return v == other.v && vt == other.vt && vn == other.vn;
+   }
+};
+
+struct obj_corner_hash {
+   size_t operator()(const obj_corner& c) const {
+      uint64_t h = (uint32_t) c.v * 0x9e3779b97f4a7c15ull;
+      h ^= ((uint32_t) c.vt + (h << 6) + (h >> 2)) * 0xbf58476d1ce4e5b9ull;
+      h ^= ((uint32_t) c.vn + (h << 6) + (h >> 2)) * 0x94d049bb133111ebull;
+      return (size_t) (h ^ (h >> 31));
+   }
+};
+
+class obj_parser {
+public:
+   obj_parser(triangle_mesh& m) : mesh(m), line_number(0) {}
+
+   // parse one line, without its end of line; false on a malformed face
+   bool parse_line(const char* s, const char* end) {
+      line_number++;
+      s = skip_space(s, end);
+      if (s == end || *s == '#') return true;
+
+      if (s[0] == 'v' && s + 1 < end && is_space(s[1]))
+      {
+         glm::vec3 p;
+         s = parse_float(s + 1, end, p.x);
+         s = parse_float(s, end, p.y);
+         parse_float(s, end, p.z);
+         positions.push_back(p);
+      }
+      else if (s[0] == 'v' && s + 2 < end && s[1] == 't' && is_space(s[2]))
+      {
+         glm::vec2 uv;
+         s = parse_float(s + 2, end, uv.x);
+         parse_float(s, end, uv.y);
+         uvs.push_back(uv);
+      }
+      else if (s[0] == 'v' && s + 2 < end && s[1] == 'n' && is_space(s[2]))
+      {
+         glm::vec3 n;
+         s = parse_float(s + 2, end, n.x);
+         s = parse_float(s, end, n.y);
+         parse_float(s, end, n.z);
+         normals.push_back(n);
+      }
+      else if (s[0] == 'f' && s + 1 < end && is_space(s[1]))
+      {
+         return parse_face(s + 1, end);
+      }
+      return true;
+   }
+
+   // copy the vertex attributes that were used into the mesh; corners without a
+   // normal get a zero one, so that their triangles use the face normal
+   void finish() {
+      if (!uvs.empty()) mesh.uvs.resize(mesh.positions.size(), glm::vec2(0));
+      if (!normals.empty()) mesh.normals.resize(mesh.positions.size(), glm::vec3(0));
+      for (const auto& entry : vertices)
+      {
+         const obj_corner& c = entry.first;
+         if (c.vt >= 0) mesh.uvs[entry.second] = uvs[c.vt];
+         if (c.vn >= 0) mesh.normals[entry.second] = normals[c.vn];
+      }
+   }
+
+   int line() const { return line_number; }
+
+private:
+   bool parse_face(const char* s, const char* end) {
+      uint32_t first = 0, previous = 0;
+      int count = 0;
+      while (true)
+      {
+         s = skip_space(s, end);
+         if (s == end || *s == '#') break;
+
+         obj_corner c = { -1, -1, -1 };
+         if (!parse_index(s, end, (int) positions.size(), c.v)) return false;
+         if (s < end && *s == '/')
+         {
+            s++;
+            if (s < end && *s != '/' && !is_space(*s))
+            {
+               if (!parse_index(s, end, (int) uvs.size(), c.vt)) return false;
+            }
+            if (s < end && *s == '/')
+            {
+               s++;
+               if (!parse_index(s, end, (int) normals.size(), c.vn)) return false;
+            }
+         }
+
+         uint32_t vertex = add_vertex(c);
+         if (count == 0) first = vertex;
+         if (count >= 2)
+         {
+            mesh.indices.push_back(first);
+            mesh.indices.push_back(previous);
+            mesh.indices.push_back(vertex);
+         }
+         previous = vertex;
+         count++;
+      }
+      return count >= 3;
+   }
+
+   uint32_t add_vertex(const obj_corner& c) {
+      auto it = vertices.find(c);
+      if (it != vertices.end()) return it->second;
+      uint32_t index = (uint32_t) mesh.positions.size();
+      mesh.positions.push_back(positions[c.v]);
+      vertices.emplace(c, index);
+      return index;
+   }
+
+   // 1-based index, or negative relative to the end of a list of size n; stored 0-based
+   static bool parse_index(const char*& s, const char* end, int n, int32_t& index) {
+      bool negative = s < end && *s == '-';
+      if (negative) s++;
+      if (s == end || *s < '0' || *s > '9') return false;
+      int value = 0;
+      while (s < end && *s >= '0' && *s <= '9') value = 10 * value + (*s++ - '0');
+      index = negative ? n - value : value - 1;
+      return index >= 0 && index < n;
+   }
+
+   // decimal number with an optional exponent; skips leading white space
+   static const char* parse_float(const char* s, const char* end, float& value) {
+      s = skip_space(s, end);
+      bool negative = false;
+      if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+
+      double mantissa = 0.0;
+      int exponent = 0;
+      while (s < end && *s >= '0' && *s <= '9') mantissa = 10.0 * mantissa + (*s++ - '0');
+      if (s < end && *s == '.')
+      {
+         s++;
+         while (s < end && *s >= '0' && *s <= '9')
+         {
+            mantissa = 10.0 * mantissa + (*s++ - '0');
+            exponent--;
+         }
+      }
+      if (s < end && (*s == 'e' || *s == 'E'))
+      {
+         s++;
+         bool negative_exponent = false;
+         if (s < end && (*s == '-' || *s == '+')) negative_exponent = *s++ == '-';
+         int e = 0;
+         while (s < end && *s >= '0' && *s <= '9') e = 10 * e + (*s++ - '0');
+         exponent += negative_exponent ? -e : e;
+      }
+
+      double result = exponent < 0 ? mantissa / pow10(-exponent) : mantissa * pow10(exponent);
+      value = (float) (negative ? -result : result);
+      return s;
+   }
+
+   static double pow10(int n) {
+      static const double table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+         1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+      return n <= 22 ? table[n] : std::pow(10.0, n);
+   }
+
+   static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+   static const char* skip_space(const char* s, const char* end) {
+      while (s < end && is_space(*s)) s++;
+      return s;
+   }
+
+   triangle_mesh& mesh;
+   int line_number;
+   std::vector<glm::vec3> positions;
+   std::vector<glm::vec2> uvs;
+   std::vector<glm::vec3> normals;
+   std::unordered_map<obj_corner, uint32_t, obj_corner_hash> vertices;
+};
+
+// Replace the contents of mesh with the triangles of an OBJ file and build its
+// hierarchy. Returns false, leaving mesh empty, if the file cannot be read or a
+// face is malformed.
+inline bool load_obj(const std::string& filename, triangle_mesh& mesh)
+{
+   mesh.positions.clear();
+   mesh.normals.clear();
+   mesh.uvs.clear();
+   mesh.indices.clear();
+
+   FILE* file = std::fopen(filename.c_str(), "rb");
+   if (!file)
+   {
+      std::cerr << "ERROR: Could not load OBJ file '" << filename << "'.\n";
+      mesh.build(); // empties the hierarchy
+      return false;
+   }
+
+   // read blocks; the unfinished last line of a block is moved to the front of the next
+   obj_parser parser(mesh);
+   std::vector<char> buffer(1 << 20);
+   size_t carried = 0;
+   bool ok = true;
+   while (ok)
+   {
+      size_t read = std::fread(buffer.data() + carried, 1, buffer.size() - carried, file);
+      size_t size = carried + read;
+      bool at_end = read == 0;
+      if (size == 0) break;
+
+      const char* s = buffer.data();
+      const char* end = s + size;
+      while (ok)
+      {
+         const char* eol = s;
+         while (eol < end && *eol != '\n') eol++;
+         if (eol == end && !at_end) break;
+         ok = parser.parse_line(s, eol);
+         s = eol == end ? end : eol + 1;
+         if (s == end) break;
+      }
+
+      carried = end - s;
+      if (at_end) break;
+      // s is kept as an offset, since growing the buffer for a very long line moves it
+      size_t offset = s - buffer.data();
+      if (carried == buffer.size()) buffer.resize(2 * buffer.size());
+      std::copy(buffer.data() + offset, buffer.data() + offset + carried, buffer.data());
+   }
+   std::fclose(file);
+
+   if (!ok)
+   {
+      std::cerr << "ERROR: Malformed face on line " << parser.line() << " of OBJ file '" << filename << "'.\n";
+      mesh.positions.clear();
+      mesh.normals.clear();
+      mesh.uvs.clear();
+      mesh.indices.clear();
+      mesh.build(); // empties the hierarchy
+      return false;
+   }
+
+   parser.finish();
+   mesh.build();
+   return true;
+}
+
+#endif
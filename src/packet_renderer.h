@@ -0,0 +1,117 @@
+// packet_renderer.h
+// Render driver for coherent camera rays. One sample of every pixel in an 8x8
+// block is traced as a ray_packet (hittable.h): the packet walks the scene's
+// hierarchy once, and boxes that none of its rays can enter are culled with a
+// single interval test instead of 64 slab tests. Paths scatter in all directions
+// after their first hit, so from there on they are shaded and traced one ray
+// at a time, as in render().
+//
+// Each sample is started on its (pixel, sample) as in render() and the camera
+// rays get the same closest hits, so the images match render() with the same
+// camera and integrator.
+
+#ifndef PACKET_RENDERER_H
+#define PACKET_RENDERER_H
+
+#include "AGLM.h"
+#include "ray.h"
+#include "hittable.h"
+#include "sampler.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// packets cover packet_width x packet_width pixels
+const int packet_width = 8;
+static_assert(packet_width * packet_width <= ray_packet::max_size, "packet_width is too large");
+
+// Render the image with camera_ray(i, j, gen), the camera ray of a sample of pixel
+// (i, j), traced in packets through world. shade(r, hit, rec, gen) returns the color
+// of the sample given the first hit of r, e.g. with the ray_color() overload that
+// takes the first hit. Uses settings.samples_per_pixel, tile_size, num_threads and
+// sampling; adaptive sampling is not supported here.
+template <class CameraFn, class ShadeFn>
+render_stats render_packets(agl::ppm_image& image, const render_settings& settings,
+   const hittable& world, const CameraFn& camera_ray, const ShadeFn& shade)
+{
+   int width = image.width();
+   int height = image.height();
+   int spp = settings.samples_per_pixel;
+   int tile = std::max(packet_width, settings.tile_size);
+   int tiles_x = (width + tile - 1) / tile;
+   int tiles_y = (height + tile - 1) / tile;
+
+   auto start = std::chrono::steady_clock::now();
+
+   thread_pool pool(settings.num_threads);
+   std::vector<sampler> samplers(pool.size(), sampler(settings.sampling, width, height, spp));
+   std::vector<ray_packet> packets(pool.size());
+   std::vector<long long> worker_rays(pool.size(), 0);
+
+   pool.parallel_for(tiles_x * tiles_y, [&](int index, int worker)
+   {
+      int x0 = (index % tiles_x) * tile;
+      int y0 = (index / tiles_x) * tile;
+      int x1 = std::min(x0 + tile, width);
+      int y1 = std::min(y0 + tile, height);
+      long long rays_before = thread_ray_count();
+      sampler& gen = samplers[worker];
+      ray_packet& packet = packets[worker];
+
+      for (int by = y0; by < y1; by += packet_width)
+      {
+         for (int bx = x0; bx < x1; bx += packet_width)
+         {
+            // ray k of a packet is pixel (bx + k % bw, by + k / bw)
+            int bw = std::min(packet_width, x1 - bx);
+            int bh = std::min(packet_width, y1 - by);
+            glm::color colors[ray_packet::max_size];
+            std::fill(colors, colors + bw * bh, glm::color(0));
+
+            for (int s = 0; s < spp; s++)
+            {
+               packet.clear();
+               for (int k = 0; k < bw * bh; k++)
+               {
+                  gen.start_pixel_sample(bx + k % bw, by + k / bw, s);
+                  packet.add(camera_ray(bx + k % bw, by + k / bw, gen));
+               }
+               packet.finish();
+               world.intersect_packet(packet, 0, packet.size);
+               thread_ray_count() += packet.size;
+
+               for (int k = 0; k < packet.size; k++)
+               {
+                  gen.start_pixel_sample(bx + k % bw, by + k / bw, s);
+                  if (packet.hit[k])
+                  {
+                     packet.rec[k].object->finalize_hit(packet.rays[k], packet.rec[k]);
+                     hittable::compute_differentials(packet.rays[k], packet.rec[k]);
+                  }
+                  colors[k] += shade(packet.rays[k], packet.hit[k], packet.rec[k], gen);
+               }
+            }
+
+            for (int k = 0; k < bw * bh; k++)
+            {
+               image.set_vec3(by + k / bw, bx + k % bw, normalize_color(colors[k], spp));
+            }
+         }
+      }
+      worker_rays[worker] += thread_ray_count() - rays_before;
+   });
+
+   render_stats stats;
+   stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   stats.threads = pool.size();
+   stats.tiles = tiles_x * tiles_y;
+   stats.samples = (long long) width * height * spp;
+   for (long long n : worker_rays) stats.rays += n;
+
+   print_render_stats(stats, width, height, "packets");
+   return stats;
+}
+
+#endif
@@ -6,11 +6,11 @@
 
 class plane : public hittable {
 public:
-   plane() : a(0), n(0), mat_ptr(0) {}
+   plane() : a(0), n(0), mat_id(0) {}
    plane(const glm::point3& p, const glm::vec3& normal, 
-      std::shared_ptr<material> m) : a(p), n(normal), mat_ptr(m) {};
+      uint32_t m) : a(p), n(normal), mat_id(m) {};
 
-   virtual bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const override
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override
    {
       
       float numerator = glm::dot(glm::vec3(a - r.origin()), n);
@@ -18,22 +18,34 @@ public:
       if (fabs(denominator) > 0.0001)
       {
           float t = numerator / denominator;
-          rec.t = t; // save the time when we hit the object
-          rec.p = r.at(t); // ray.origin + t * ray.direction
-          rec.mat_ptr = mat_ptr;
+          if (t < t_min || t > t_max) return false;
 
-          glm::vec3 outward_normal = normalize(n); // compute unit length normal
-          rec.set_face_normal(r, outward_normal);
-          //get_uv_coordinates();
-          return (t >= 0);
+          rec.t = t; // save the time when we hit the object
+          rec.mat_id = mat_id;
+          rec.object = this;
+          return true;
       }
       return false;
    }
 
+   virtual void finalize_hit(const ray& r, hit_record& rec) const override
+   {
+      rec.p = r.at(rec.t); // ray.origin + t * ray.direction
+
+      glm::vec3 outward_normal = normalize(n); // compute unit length normal
+      rec.set_face_normal(r, outward_normal);
+      //get_uv_coordinates();
+   }
+
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override
+   {
+      return false; // planes are infinite
+   }
+
 public:
    glm::vec3 a;
    glm::vec3 n;
-   std::shared_ptr<material> mat_ptr;
+   uint32_t mat_id; // index into the scene's material_table
 
 private:
     static void get_uv_coordinates(const glm::point3& p, float& u, float& v) {
@@ -0,0 +1,647 @@
+// primitive_bvh.h
+// A bounding volume hierarchy that calls the built-in primitives without virtual
+// calls. Spheres, moving spheres, triangles and planes are copied into one array
+// per type, in the order the leaves visit them. A leaf entry is a (type, index)
+// pair, and a switch on the type calls that primitive's intersect() by its full
+// name, so the compiler can inline it. Any other hittable (sphere_set,
+// triangle_mesh, box, a class derived from a primitive, ...) is kept by pointer
+// and called through the hittable interface as before.
+//
+// The nodes are a flat array, as in triangle_mesh, and are walked with a stack
+// instead of a virtual call per node. scene builds one in build().
+//
+// For motion blur, a node that bounds moving objects stores its box at shutter
+// open and at shutter close, and a ray tests the box interpolated to its time
+// (ray::getTime()). A static hierarchy would have to bound the whole volume each
+// object sweeps during the shutter, which gets loose for fast movers. Objects are
+// assumed to move linearly over the shutter, as moving_sphere does.
+//
+// For animation, update() refits the hierarchy to objects that have moved since
+// build(), in a fraction of the time of a new build. Boxes are recomputed bottom-up
+// and only subtrees whose surface area cost has degraded past rebuild_threshold
+// are built again.
+
+#ifndef PRIMITIVE_BVH_H
+#define PRIMITIVE_BVH_H
+
+#include "hittable.h"
+#include "bvh.h"
+#include "sphere.h"
+#include "moving_sphere.h"
+#include "triangle.h"
+#include "plane.h"
+#include "AGLM.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class primitive_bvh : public hittable {
+public:
+   primitive_bvh() : motion_bounds(true), rebuild_threshold(1.5f), rebuilds(0), time0(0.0f), time1(0.0f), inv_shutter(0.0f) {}
+
+   // Add an object, by its static type: sphere, moving_sphere, triangle and plane go
+   // to their typed arrays, and anything else is called through hittable. Objects are
+   // copied by build(), so they must stay alive until then; other objects must stay
+   // alive as long as the hierarchy is used.
+   void add(const sphere* s) { pending.push_back(std::make_pair(type_sphere, s)); }
+   void add(const moving_sphere* s) { pending.push_back(std::make_pair(type_moving_sphere, s)); }
+   void add(const triangle* t) { pending.push_back(std::make_pair(type_triangle, t)); }
+   void add(const plane* p) { pending.push_back(std::make_pair(type_plane, p)); }
+   template <class T>
+   void add(const T* object) { pending.push_back(std::make_pair(type_other, object)); }
+
+   // copy the primitives added so far and build the hierarchy over them, for shutter
+   // times [time0, time1]
+   void build(float time0 = 0.0f, float time1 = 0.0f);
+
+   // Update the hierarchy after the objects added to it have moved or changed shape,
+   // for the shutter times of the last build(). The primitives are copied again, the boxes are
+   // refit bottom-up, and subtrees whose cost grew past rebuild_threshold times their
+   // cost when they were built are built again. Objects added since build() (or objects
+   // that lost their bounding box) make this a full build().
+   void update();
+
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override;
+   virtual void intersect_packet(ray_packet& packet, int first, int last) const override;
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override;
+
+   // most primitives in a leaf of the hierarchy
+   static const int max_leaf_size = 4;
+
+   // false => nodes bound the whole volume swept during the shutter, as bvh_node does
+   bool motion_bounds;
+
+   // update() rebuilds a subtree once its surface area cost reaches this many times
+   // its cost when built; rebuilds counts the subtrees the last update() rebuilt
+   float rebuild_threshold;
+   int rebuilds;
+
+private:
+   enum prim_type : uint32_t { type_sphere, type_moving_sphere, type_triangle, type_plane, type_other };
+
+   // a primitive: index into the array of its type (others for type_other)
+   struct prim_ref {
+      prim_type type;
+      uint32_t index;
+   };
+
+   struct node {
+      aabb box;
+      uint32_t offset; // leaf: index of its first entry in refs; inner: index of the second child (the first is next)
+      uint16_t count; // primitives in a leaf, 0 for inner nodes
+      uint16_t axis; // split axis of an inner node
+   };
+
+   struct build_prim {
+      aabb box; // over the whole shutter interval
+      aabb start_box, end_box; // at shutter open and close
+      glm::point3 centroid;
+      prim_type type;
+      uint32_t index; // into the array of its type, once stored (update())
+      const hittable* object;
+   };
+
+   bool set_bounds(build_prim& prim, float time0, float time1) const;
+   uint32_t build_node(std::vector<build_prim>& prims, size_t start, size_t end, bool moving);
+   void rebuild_subtree(uint32_t index, std::vector<build_prim>& prims, bool moving);
+   prim_ref store(prim_type type, const hittable* object);
+   void copy_again(const prim_ref& ref, const hittable* object);
+
+   // box of node index over the whole shutter interval
+   aabb swept_box(uint32_t index) const {
+      if (end_boxes.empty()) return nodes[index].box;
+      return surrounding_box(nodes[index].box, end_boxes[index]);
+   }
+
+   // Surface area cost of the subtree under node index, not divided by the area of its
+   // root, with costs holding the costs of the nodes below it. A leaf costs its area
+   // times its primitives, an inner node its area (a traversal step) plus its children.
+   // Boxes that grow raise the cost of every node above them, not only their own.
+   float subtree_cost(uint32_t index, const std::vector<float>& costs) const {
+      const node& n = nodes[index];
+      float area = swept_box(index).surface_area();
+      if (n.count > 0) return area * n.count;
+      return area + costs[index + 1] + costs[n.offset];
+   }
+
+   // where the time of r falls in the shutter interval, from 0 (open) to 1 (close)
+   float shutter_fraction(const ray& r) const { return (r.getTime() - time0) * inv_shutter; }
+
+   // does r meet the box of node index, at the shutter fraction s of the ray?
+   bool box_hit(uint32_t index, const ray& r, float s, float t_min, float t_max) const {
+      if (end_boxes.empty()) return nodes[index].box.hit(r, t_min, t_max);
+      const aabb& b0 = nodes[index].box;
+      const aabb& b1 = end_boxes[index];
+      aabb b(b0.minimum + s * (b1.minimum - b0.minimum), b0.maximum + s * (b1.maximum - b0.maximum));
+      return b.hit(r, t_min, t_max);
+   }
+
+   bool box_hit(uint32_t index, const ray_packet& packet, int k) const {
+      return box_hit(index, packet.rays[k], shutter_fraction(packet.rays[k]), packet.t_min, packet.t_max[k]);
+   }
+
+   // ray_packet::first_hit() and last_hit() for the box of node index
+   int first_ray(const ray_packet& packet, uint32_t index, int first, int last) const;
+   int last_ray(const ray_packet& packet, uint32_t index, int first, int last) const;
+
+   // hittable::intersect() of one primitive, called by its full name
+   bool intersect_prim(const prim_ref& ref, const ray& r, float t_min, float t_max, hit_record& rec) const {
+      switch (ref.type)
+      {
+      case type_sphere: return spheres[ref.index].sphere::intersect(r, t_min, t_max, rec);
+      case type_moving_sphere: return moving_spheres[ref.index].moving_sphere::intersect(r, t_min, t_max, rec);
+      case type_triangle: return triangles[ref.index].triangle::intersect(r, t_min, t_max, rec);
+      case type_plane: return planes[ref.index].plane::intersect(r, t_min, t_max, rec);
+      default: return others[ref.index]->intersect(r, t_min, t_max, rec);
+      }
+   }
+
+   // the rays [first, last) of a packet against one primitive
+   void intersect_prim(const prim_ref& ref, ray_packet& packet, int first, int last) const {
+      switch (ref.type)
+      {
+      case type_sphere: intersect_rays(spheres[ref.index], packet, first, last); break;
+      case type_moving_sphere: intersect_rays(moving_spheres[ref.index], packet, first, last); break;
+      case type_triangle: intersect_rays(triangles[ref.index], packet, first, last); break;
+      case type_plane: intersect_rays(planes[ref.index], packet, first, last); break;
+      default: others[ref.index]->intersect_packet(packet, first, last); break;
+      }
+   }
+
+   template <class T>
+   static void intersect_rays(const T& object, ray_packet& packet, int first, int last) {
+      for (int k = first; k < last; k++)
+      {
+         if (object.T::intersect(packet.rays[k], packet.t_min, packet.t_max[k], packet.rec[k]))
+         {
+            packet.t_max[k] = packet.rec[k].t;
+            packet.hit[k] = true;
+         }
+      }
+   }
+
+   std::vector<std::pair<prim_type, const hittable*>> pending; // added, waiting for build()
+   std::vector<node> nodes; // nodes[0] is the root
+   std::vector<aabb> end_boxes; // box of each node at shutter close, with nodes[].box at open; empty if nothing moves
+   float time0, time1, inv_shutter; // shutter of the last build()
+   std::vector<prim_ref> refs; // the primitives of the leaves, in leaf order
+   std::vector<prim_ref> unbounded; // objects without a box (e.g. planes), tested by every ray
+   std::vector<const hittable*> sources; // the object each entry of refs was copied from
+   std::vector<const hittable*> unbounded_sources;
+   std::vector<float> build_costs; // subtree_cost() of each node when it was built
+
+   std::vector<sphere> spheres;
+   std::vector<moving_sphere> moving_spheres;
+   std::vector<triangle> triangles;
+   std::vector<plane> planes;
+   std::vector<const hittable*> others;
+};
+
+inline void primitive_bvh::build(float time0, float time1)
+{
+   nodes.clear();
+   end_boxes.clear();
+   build_costs.clear();
+   refs.clear();
+   unbounded.clear();
+   sources.clear();
+   unbounded_sources.clear();
+   spheres.clear();
+   moving_spheres.clear();
+   triangles.clear();
+   planes.clear();
+   others.clear();
+
+   this->time0 = time0;
+   this->time1 = time1;
+   inv_shutter = time1 > time0 ? 1.0f / (time1 - time0) : 0.0f;
+   bool moving = false;
+
+   std::vector<build_prim> prims;
+   prims.reserve(pending.size());
+   for (const auto& entry : pending)
+   {
+      build_prim prim;
+      prim.type = entry.first;
+      prim.index = 0;
+      prim.object = entry.second;
+      if (!set_bounds(prim, time0, time1))
+      {
+         unbounded.push_back(store(prim.type, prim.object));
+         unbounded_sources.push_back(prim.object);
+         continue;
+      }
+      moving = moving || prim.start_box.minimum != prim.end_box.minimum || prim.start_box.maximum != prim.end_box.maximum;
+      prims.push_back(prim);
+   }
+   if (prims.empty()) return;
+
+   nodes.reserve(2 * prims.size() / max_leaf_size + 1);
+   build_node(prims, 0, prims.size(), moving);
+   nodes.shrink_to_fit();
+   build_costs.shrink_to_fit();
+   if (moving) end_boxes.shrink_to_fit();
+   else std::vector<aabb>().swap(end_boxes);
+
+   // copy the primitives in leaf order, so that a leaf reads neighboring elements
+   refs.reserve(prims.size());
+   sources.reserve(prims.size());
+   for (const build_prim& prim : prims)
+   {
+      refs.push_back(store(prim.type, prim.object));
+      sources.push_back(prim.object);
+   }
+}
+
+// Box and centroid of prim.object over [time0, time1], and its boxes at both ends
+// of the shutter (the same box for objects that do not move); false if it has no box.
+inline bool primitive_bvh::set_bounds(build_prim& prim, float time0, float time1) const
+{
+   if (!prim.object->bounding_box(time0, time1, prim.box)) return false;
+
+   prim.centroid = prim.box.centroid();
+   prim.start_box = prim.end_box = prim.box;
+   if (motion_bounds && time1 > time0)
+   {
+      prim.object->bounding_box(time0, time0, prim.start_box);
+      prim.object->bounding_box(time1, time1, prim.end_box);
+      if (prim.start_box.minimum != prim.end_box.minimum || prim.start_box.maximum != prim.end_box.maximum)
+      {
+         // pad the boxes, so that rounding in the interpolation cannot cut off the object
+         glm::vec3 pad(0.0001f);
+         prim.start_box = aabb(prim.start_box.minimum - pad, prim.start_box.maximum + pad);
+         prim.end_box = aabb(prim.end_box.minimum - pad, prim.end_box.maximum + pad);
+      }
+      else
+      {
+         prim.start_box = prim.end_box = prim.box;
+      }
+   }
+   return true;
+}
+
+// copy a primitive to the array of its type, or keep the pointer of another object
+inline primitive_bvh::prim_ref primitive_bvh::store(prim_type type, const hittable* object)
+{
+   prim_ref ref;
+   ref.type = type;
+   switch (type)
+   {
+   case type_sphere:
+      ref.index = (uint32_t) spheres.size();
+      spheres.push_back(*static_cast<const sphere*>(object));
+      break;
+   case type_moving_sphere:
+      ref.index = (uint32_t) moving_spheres.size();
+      moving_spheres.push_back(*static_cast<const moving_sphere*>(object));
+      break;
+   case type_triangle:
+      ref.index = (uint32_t) triangles.size();
+      triangles.push_back(*static_cast<const triangle*>(object));
+      break;
+   case type_plane:
+      ref.index = (uint32_t) planes.size();
+      planes.push_back(*static_cast<const plane*>(object));
+      break;
+   default:
+      ref.index = (uint32_t) others.size();
+      others.push_back(object);
+      break;
+   }
+   return ref;
+}
+
+// copy a primitive to the place it was stored at again, after it changed
+inline void primitive_bvh::copy_again(const prim_ref& ref, const hittable* object)
+{
+   switch (ref.type)
+   {
+   case type_sphere: spheres[ref.index] = *static_cast<const sphere*>(object); break;
+   case type_moving_sphere: moving_spheres[ref.index] = *static_cast<const moving_sphere*>(object); break;
+   case type_triangle: triangles[ref.index] = *static_cast<const triangle*>(object); break;
+   case type_plane: planes[ref.index] = *static_cast<const plane*>(object); break;
+   default: break; // others are called through their pointer
+   }
+}
+
+// the split is chosen with the boxes over the whole shutter interval
+inline uint32_t primitive_bvh::build_node(std::vector<build_prim>& prims, size_t start, size_t end, bool moving)
+{
+   uint32_t index = (uint32_t) nodes.size();
+   nodes.push_back(node());
+   end_boxes.push_back(aabb());
+   build_costs.push_back(0.0f);
+
+   aabb box, start_box, end_box, centroid_bounds;
+   for (size_t i = start; i < end; i++)
+   {
+      box.expand(prims[i].box);
+      start_box.expand(prims[i].start_box);
+      end_box.expand(prims[i].end_box);
+      centroid_bounds.expand(prims[i].centroid);
+   }
+   nodes[index].box = moving ? start_box : box;
+   end_boxes[index] = end_box;
+
+   if (end - start <= (size_t) max_leaf_size)
+   {
+      nodes[index].offset = (uint32_t) start;
+      nodes[index].count = (uint16_t) (end - start);
+      nodes[index].axis = 0;
+      build_costs[index] = subtree_cost(index, build_costs);
+      return index;
+   }
+
+   int axis = 0;
+   size_t mid = sah_split(prims, start, end, centroid_bounds, axis);
+   build_node(prims, start, mid, moving);
+   uint32_t second = build_node(prims, mid, end, moving);
+   nodes[index].offset = second;
+   nodes[index].count = 0;
+   nodes[index].axis = (uint16_t) axis;
+   build_costs[index] = subtree_cost(index, build_costs);
+   return index;
+}
+
+inline void primitive_bvh::update()
+{
+   rebuilds = 0;
+   if (refs.size() + unbounded.size() != pending.size())
+   {
+      build(time0, time1);
+      return;
+   }
+
+   for (size_t i = 0; i < unbounded.size(); i++)
+   {
+      copy_again(unbounded[i], unbounded_sources[i]);
+   }
+
+   // the primitives and their new bounds, in leaf order
+   bool moving = false;
+   std::vector<build_prim> prims(refs.size());
+   for (size_t i = 0; i < refs.size(); i++)
+   {
+      copy_again(refs[i], sources[i]);
+      build_prim& prim = prims[i];
+      prim.type = refs[i].type;
+      prim.index = refs[i].index;
+      prim.object = sources[i];
+      if (!set_bounds(prim, time0, time1))
+      {
+         build(time0, time1);
+         return;
+      }
+      moving = moving || prim.start_box.minimum != prim.end_box.minimum || prim.start_box.maximum != prim.end_box.maximum;
+   }
+   if (nodes.empty()) return;
+   if (moving == end_boxes.empty())
+   {
+      // objects started or stopped moving: the nodes need a box at shutter close, or lose it
+      build(time0, time1);
+      return;
+   }
+
+   // refit from the leaves up; the children of a node come after it
+   std::vector<float> costs(nodes.size());
+   for (size_t k = nodes.size(); k > 0; k--)
+   {
+      uint32_t index = (uint32_t) (k - 1);
+      node& n = nodes[index];
+      aabb start_box, end_box;
+      if (n.count > 0)
+      {
+         for (uint32_t i = n.offset; i < n.offset + n.count; i++)
+         {
+            start_box.expand(prims[i].start_box);
+            end_box.expand(prims[i].end_box);
+         }
+      }
+      else
+      {
+         start_box = surrounding_box(nodes[index + 1].box, nodes[n.offset].box);
+         if (moving) end_box = surrounding_box(end_boxes[index + 1], end_boxes[n.offset]);
+      }
+      n.box = start_box;
+      if (moving) end_boxes[index] = end_box;
+      costs[index] = subtree_cost(index, costs);
+   }
+
+   // find the largest subtrees that degraded, in increasing node order
+   std::vector<uint32_t> degraded;
+   uint32_t stack[64];
+   int stack_size = 0;
+   stack[stack_size++] = 0;
+   while (stack_size > 0)
+   {
+      uint32_t index = stack[--stack_size];
+      const node& n = nodes[index];
+      if (n.count > 0) continue;
+      if (costs[index] > rebuild_threshold * build_costs[index])
+      {
+         degraded.push_back(index);
+         continue;
+      }
+      stack[stack_size++] = n.offset;
+      stack[stack_size++] = index + 1;
+   }
+
+   // rebuild the last one first, so that the nodes of the others do not move
+   for (size_t k = degraded.size(); k > 0; k--)
+   {
+      rebuild_subtree(degraded[k - 1], prims, moving);
+   }
+   rebuilds = (int) degraded.size();
+}
+
+// Build the subtree under node index again from prims, which hold the current bounds
+// of all the primitives in leaf order. The new subtree covers the same primitives, but
+// may have a different number of nodes, so the nodes after it shift.
+inline void primitive_bvh::rebuild_subtree(uint32_t index, std::vector<build_prim>& prims, bool moving)
+{
+   // the subtree is nodes [index, end_index) and its leaves hold the primitives [start, end)
+   uint32_t first_leaf = index, last_leaf = index;
+   while (nodes[first_leaf].count == 0) first_leaf++;
+   while (nodes[last_leaf].count == 0) last_leaf = nodes[last_leaf].offset;
+   uint32_t end_index = last_leaf + 1;
+   size_t start = nodes[first_leaf].offset;
+   size_t end = nodes[last_leaf].offset + nodes[last_leaf].count;
+
+   std::vector<node> outer_nodes;
+   std::vector<aabb> outer_end_boxes;
+   std::vector<float> outer_costs;
+   outer_nodes.swap(nodes);
+   outer_end_boxes.swap(end_boxes);
+   outer_costs.swap(build_costs);
+   build_node(prims, start, end, moving);
+
+   // the new inner nodes point to their second child from the start of the subtree,
+   // and nodes after the subtree move by the difference in size
+   long shift = (long) nodes.size() - (long) (end_index - index);
+   for (node& n : nodes)
+   {
+      if (n.count == 0) n.offset += index;
+   }
+   for (node& n : outer_nodes)
+   {
+      if (n.count == 0 && n.offset >= end_index) n.offset = (uint32_t) (n.offset + shift);
+   }
+   outer_nodes.erase(outer_nodes.begin() + index, outer_nodes.begin() + end_index);
+   outer_nodes.insert(outer_nodes.begin() + index, nodes.begin(), nodes.end());
+   outer_costs.erase(outer_costs.begin() + index, outer_costs.begin() + end_index);
+   outer_costs.insert(outer_costs.begin() + index, build_costs.begin(), build_costs.end());
+   if (moving)
+   {
+      outer_end_boxes.erase(outer_end_boxes.begin() + index, outer_end_boxes.begin() + end_index);
+      outer_end_boxes.insert(outer_end_boxes.begin() + index, end_boxes.begin(), end_boxes.end());
+   }
+   nodes.swap(outer_nodes);
+   end_boxes.swap(outer_end_boxes);
+   build_costs.swap(outer_costs);
+
+   // the leaves of the subtree now visit its primitives in the order of prims
+   for (size_t i = start; i < end; i++)
+   {
+      refs[i].type = prims[i].type;
+      refs[i].index = prims[i].index;
+      sources[i] = prims[i].object;
+   }
+}
+
+inline bool primitive_bvh::intersect(const ray& r, float t_min, float t_max, hit_record& rec) const
+{
+   bool hit_anything = false;
+   float closest_so_far = t_max;
+
+   for (const prim_ref& ref : unbounded)
+   {
+      if (intersect_prim(ref, r, t_min, closest_so_far, rec))
+      {
+         hit_anything = true;
+         closest_so_far = rec.t;
+      }
+   }
+   if (nodes.empty()) return hit_anything;
+
+   float s = shutter_fraction(r);
+   uint32_t stack[64];
+   int stack_size = 0;
+   uint32_t current = 0;
+   while (true)
+   {
+      const node& n = nodes[current];
+      if (box_hit(current, r, s, t_min, closest_so_far))
+      {
+         if (n.count > 0)
+         {
+            for (uint32_t i = n.offset; i < n.offset + n.count; i++)
+            {
+               if (intersect_prim(refs[i], r, t_min, closest_so_far, rec))
+               {
+                  hit_anything = true;
+                  closest_so_far = rec.t;
+               }
+            }
+         }
+         else
+         {
+            // visit the child on the near side of the split first
+            uint32_t first = current + 1;
+            uint32_t second = n.offset;
+            if (r.dir[n.axis] < 0.0f) std::swap(first, second);
+            stack[stack_size++] = second;
+            current = first;
+            continue;
+         }
+      }
+      if (stack_size == 0) break;
+      current = stack[--stack_size];
+   }
+   return hit_anything;
+}
+
+// as bvh_node::intersect_packet, each node passes down the range of rays from the
+// first to the last that enter its box
+inline void primitive_bvh::intersect_packet(ray_packet& packet, int first, int last) const
+{
+   for (const prim_ref& ref : unbounded)
+   {
+      intersect_prim(ref, packet, first, last);
+   }
+   if (nodes.empty()) return;
+
+   struct entry {
+      uint32_t node;
+      int first, last;
+   };
+   entry stack[64];
+   int stack_size = 0;
+   entry current = { 0, first, last };
+   while (true)
+   {
+      const node& n = nodes[current.node];
+      int f = first_ray(packet, current.node, current.first, current.last);
+      if (f < current.last)
+      {
+         int l = last_ray(packet, current.node, f, current.last);
+         if (n.count > 0)
+         {
+            for (uint32_t i = n.offset; i < n.offset + n.count; i++)
+            {
+               intersect_prim(refs[i], packet, f, l);
+            }
+         }
+         else
+         {
+            uint32_t nearer = current.node + 1;
+            uint32_t farther = n.offset;
+            if (packet.rays[f].dir[n.axis] < 0.0f) std::swap(nearer, farther);
+            entry second = { farther, f, l };
+            stack[stack_size++] = second;
+            current.node = nearer;
+            current.first = f;
+            current.last = l;
+            continue;
+         }
+      }
+      if (stack_size == 0) break;
+      current = stack[--stack_size];
+   }
+}
+
+// rays with different times meet different boxes, so the packet's interval test
+// uses the box over the whole shutter
+inline int primitive_bvh::first_ray(const ray_packet& packet, uint32_t index, int first, int last) const
+{
+   if (end_boxes.empty()) return packet.first_hit(nodes[index].box, first, last);
+
+   if (box_hit(index, packet, first)) return first;
+   if (packet.coherent && !packet.may_hit(surrounding_box(nodes[index].box, end_boxes[index]))) return last;
+   for (int k = first + 1; k < last; k++)
+   {
+      if (box_hit(index, packet, k)) return k;
+   }
+   return last;
+}
+
+inline int primitive_bvh::last_ray(const ray_packet& packet, uint32_t index, int first, int last) const
+{
+   if (end_boxes.empty()) return packet.last_hit(nodes[index].box, first, last);
+
+   for (int k = last - 1; k > first; k--)
+   {
+      if (box_hit(index, packet, k)) return k + 1;
+   }
+   return first + 1;
+}
+
+inline bool primitive_bvh::bounding_box(float time0, float time1, aabb& output_box) const
+{
+   if (!unbounded.empty() || nodes.empty()) return false;
+   output_box = nodes[0].box;
+   if (!end_boxes.empty()) output_box.expand(end_boxes[0]);
+   return true;
+}
+
+#endif
@@ -11,13 +11,27 @@ public:
    ray() {}
 
    ray(const glm::point3& origin, const glm::vec3& direction, float _time =0.0)
-      : orig(origin), dir(direction), time(_time)
+      : orig(origin), dir(direction), inv_dir(1.0f / direction), time(_time)
    {}
 
    glm::point3 origin() const  { return orig; }
    glm::vec3 direction() const { return dir; }
+   const glm::vec3& inv_direction() const { return inv_dir; } // cached for bounding box tests
    float getTime() const { return time; }
 
+   // Ray differentials (Igehy 1999): the rays through the next pixel in x and in y,
+   // which bound the footprint of the pixel wherever the ray goes. They are optional;
+   // camera::get_ray_differential() sets them and materials carry them to the rays
+   // they scatter, so that hits can filter textures over the footprint (hittable.h).
+   void set_differentials(const glm::point3& x_origin, const glm::vec3& x_direction,
+      const glm::point3& y_origin, const glm::vec3& y_direction) {
+      has_differentials = true;
+      rx_orig = x_origin;
+      rx_dir = x_direction;
+      ry_orig = y_origin;
+      ry_dir = y_direction;
+   }
+
    glm::point3 at(float t) const {
       return orig + t*dir;
    }
@@ -32,8 +46,21 @@ public:
 public:
    glm::point3 orig;
    glm::vec3 dir;
+   glm::vec3 inv_dir;
    float time;
+
+   bool has_differentials = false;
+   glm::point3 rx_orig, ry_orig;
+   glm::vec3 rx_dir, ry_dir;
 };
 
+// number of rays the calling thread has traced, counted by the integrators
+// so that render() can report rays per second
+inline long long& thread_ray_count()
+{
+   static thread_local long long count = 0;
+   return count;
+}
+
 #endif
 
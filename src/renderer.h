@@ -0,0 +1,284 @@
+// renderer.h
+// Shared render driver: splits the image into tiles and shades them on a
+// work-stealing thread pool. Tiles never overlap, so workers write their
+// pixels straight into the image without locking.
+// In adaptive mode each pixel keeps a running mean and variance and stops
+// sampling once its estimated noise drops below a threshold.
+// Each worker owns a sampler (see sampler.h) that is restarted for every
+// sample, so sample values depend only on the pixel and sample index.
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "AGLM.h"
+#include "ppm_image.h"
+#include "ray.h"
+#include "thread_pool.h"
+#include "sampler.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct render_settings {
+   render_settings(int spp = 10) : samples_per_pixel(spp), tile_size(16), num_threads(0),
+      sampling(sampling_method::sobol), adaptive(false), min_samples(spp), max_samples(spp), noise_threshold(0.01f) {}
+
+   // sample each pixel between min_spp and max_spp times, stopping once the
+   // standard error of its mean is below threshold (in gamma-corrected [0, 1] units)
+   void set_adaptive(int min_spp, int max_spp, float threshold) {
+      adaptive = true;
+      min_samples = std::max(2, min_spp);
+      max_samples = std::max(min_samples, max_spp);
+      noise_threshold = threshold;
+   }
+
+   int samples_per_pixel; // higher => more anti-aliasing
+   int tile_size; // width and height of a tile in pixels
+   int num_threads; // 0 => one per hardware core
+   sampling_method sampling; // independent => plain random numbers
+
+   bool adaptive;
+   int min_samples;
+   int max_samples;
+   float noise_threshold;
+   std::string heatmap_file; // if set, save an image of the samples taken per pixel
+};
+
+struct render_stats {
+   double seconds = 0.0;
+   int threads = 0;
+   int tiles = 0;
+   long long samples = 0; // total camera samples over the image
+   long long rays = 0; // rays traced, including shadow rays
+};
+
+inline void print_render_stats(const render_stats& stats, int width, int height, const char* label = "")
+{
+   std::cout << "Rendered " << width << "x" << height << " (" << double(stats.samples) / (width * height)
+      << " spp average) in " << stats.seconds << " s on " << stats.threads << " threads";
+   if (stats.rays > 0)
+   {
+      std::cout << ", " << stats.rays / stats.seconds * 1e-6 << " Mrays/s";
+   }
+   if (*label) std::cout << " (" << label << ")";
+   std::cout << "\n";
+}
+
+// average the accumulated samples, clamp and apply gamma correction
+inline glm::color normalize_color(const glm::color& c, int samples_per_pixel)
+{
+   float scale = 1.0f / samples_per_pixel;
+   float r = std::min(0.999f, std::max(0.0f, c.r * scale));
+   float g = std::min(0.999f, std::max(0.0f, c.g * scale));
+   float b = std::min(0.999f, std::max(0.0f, c.b * scale));
+
+   // apply gamma correction
+   r = sqrt(r);
+   g = sqrt(g);
+   b = sqrt(b);
+
+   return glm::color(r, g, b);
+}
+
+// color ramp from blue (min_samples) to red (max_samples)
+inline void save_sample_heatmap(const std::vector<int>& counts, int width, int height,
+   int min_samples, int max_samples, const std::string& filename)
+{
+   agl::ppm_image heatmap(width, height);
+   float range = (float) std::max(1, max_samples - min_samples);
+   for (int j = 0; j < height; j++)
+   {
+      for (int i = 0; i < width; i++)
+      {
+         float t = glm::clamp((counts[j * width + i] - min_samples) / range, 0.0f, 1.0f);
+         glm::color c = t < 0.5f ?
+            glm::mix(glm::color(0, 0, 1), glm::color(0, 1, 0), 2.0f * t) :
+            glm::mix(glm::color(0, 1, 0), glm::color(1, 0, 0), 2.0f * t - 1.0f);
+         heatmap.set_vec3(j, i, c);
+      }
+   }
+   heatmap.save(filename);
+}
+
+// running estimate of one pixel, with Welford's mean and variance of the sample luminance
+struct pixel_estimate {
+   glm::color sum = glm::color(0);
+   float mean = 0.0f;
+   float m2 = 0.0f;
+   int n = 0;
+
+   void add(const glm::color& value) {
+      sum += value;
+      n++;
+      float y = glm::dot(value, glm::color(0.2126f, 0.7152f, 0.0722f));
+      float delta = y - mean;
+      mean += delta / n;
+      m2 += delta * (y - mean);
+   }
+
+   // standard error of the displayed value; since the display is sqrt(mean),
+   // that is about stderr / (2 sqrt(mean))
+   float display_error() const {
+      if (n < 2) return infinity;
+      float std_error = sqrt(m2 / (n - 1) / n);
+      return std_error / (2.0f * sqrt(std::max(mean, 0.0001f)));
+   }
+};
+
+// Adaptive sampling of the tile [x0, x1) x [y0, y1). Every pixel first gets min_samples;
+// then, in rounds, pixels whose 3x3 neighborhood is still above the noise threshold get
+// more samples, about half again as many as they have. Looking at the neighborhood keeps
+// a pixel that saw no variance by chance (e.g. next to an edge) from stopping too early.
+// Returns the number of samples taken.
+template <class SampleFn>
+long long render_adaptive_tile(agl::ppm_image& image, const render_settings& settings,
+   int x0, int y0, int x1, int y1, std::vector<int>& counts, sampler& gen, const SampleFn& sample)
+{
+   int width = image.width();
+   int tw = x1 - x0;
+   int th = y1 - y0;
+   std::vector<pixel_estimate> pixels(tw * th);
+   std::vector<float> error(tw * th);
+   long long total = 0;
+
+   auto take_samples = [&](int x, int y, int count)
+   {
+      pixel_estimate& p = pixels[y * tw + x];
+      int i = x0 + x;
+      int j = y0 + y;
+      for (int k = 0; k < count; k++)
+      {
+         gen.start_pixel_sample(i, j, p.n);
+         p.add(sample(i, j, gen));
+      }
+      total += count;
+   };
+
+   for (int y = 0; y < th; y++)
+   {
+      for (int x = 0; x < tw; x++)
+      {
+         take_samples(x, y, settings.min_samples);
+      }
+   }
+
+   bool refining = true;
+   while (refining)
+   {
+      refining = false;
+      for (int k = 0; k < tw * th; k++)
+      {
+         error[k] = pixels[k].display_error();
+      }
+
+      for (int y = 0; y < th; y++)
+      {
+         for (int x = 0; x < tw; x++)
+         {
+            int n = pixels[y * tw + x].n;
+            if (n >= settings.max_samples) continue;
+
+            float worst = 0.0f;
+            for (int ny = std::max(0, y - 1); ny <= std::min(th - 1, y + 1); ny++)
+            {
+               for (int nx = std::max(0, x - 1); nx <= std::min(tw - 1, x + 1); nx++)
+               {
+                  worst = std::max(worst, error[ny * tw + nx]);
+               }
+            }
+
+            if (worst > settings.noise_threshold)
+            {
+               take_samples(x, y, std::min(settings.max_samples - n, std::max(1, n / 2)));
+               refining = true;
+            }
+         }
+      }
+   }
+
+   for (int y = 0; y < th; y++)
+   {
+      for (int x = 0; x < tw; x++)
+      {
+         const pixel_estimate& p = pixels[y * tw + x];
+         image.set_vec3(y0 + y, x0 + x, normalize_color(p.sum, p.n));
+         if (!counts.empty()) counts[(y0 + y) * width + x0 + x] = p.n;
+      }
+   }
+   return total;
+}
+
+// sample(i, j, gen) returns the color of one sample for the pixel in column i, row j;
+// gen is started on (pixel, sample) so the image does not depend on the thread count
+template <class SampleFn>
+render_stats render(agl::ppm_image& image, const render_settings& settings, const SampleFn& sample)
+{
+   int width = image.width();
+   int height = image.height();
+   int tile = std::max(1, settings.tile_size);
+   int tiles_x = (width + tile - 1) / tile;
+   int tiles_y = (height + tile - 1) / tile;
+
+   auto start = std::chrono::steady_clock::now();
+
+   thread_pool pool(settings.num_threads);
+   std::vector<long long> worker_samples(pool.size(), 0);
+   std::vector<long long> worker_rays(pool.size(), 0);
+   std::vector<int> counts(settings.heatmap_file.empty() ? 0 : width * height, 0);
+   int max_spp = settings.adaptive ? settings.max_samples : settings.samples_per_pixel;
+   std::vector<sampler> samplers(pool.size(), sampler(settings.sampling, width, height, max_spp));
+
+   pool.parallel_for(tiles_x * tiles_y, [&](int index, int worker)
+   {
+      int x0 = (index % tiles_x) * tile;
+      int y0 = (index / tiles_x) * tile;
+      int x1 = std::min(x0 + tile, width);
+      int y1 = std::min(y0 + tile, height);
+      long long rays_before = thread_ray_count();
+
+      if (settings.adaptive)
+      {
+         worker_samples[worker] += render_adaptive_tile(image, settings, x0, y0, x1, y1, counts, samplers[worker], sample);
+         worker_rays[worker] += thread_ray_count() - rays_before;
+         return;
+      }
+
+      sampler& gen = samplers[worker];
+      for (int j = y0; j < y1; j++)
+      {
+         for (int i = x0; i < x1; i++)
+         {
+            glm::color c(0, 0, 0);
+            for (int s = 0; s < settings.samples_per_pixel; s++) // antialias
+            {
+               gen.start_pixel_sample(i, j, s);
+               c += sample(i, j, gen);
+            }
+            image.set_vec3(j, i, normalize_color(c, settings.samples_per_pixel));
+            if (!counts.empty()) counts[j * width + i] = settings.samples_per_pixel;
+         }
+      }
+      worker_samples[worker] += (long long) (x1 - x0) * (y1 - y0) * settings.samples_per_pixel;
+      worker_rays[worker] += thread_ray_count() - rays_before;
+   });
+
+   render_stats stats;
+   stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   stats.threads = pool.size();
+   stats.tiles = tiles_x * tiles_y;
+   for (long long n : worker_samples) stats.samples += n;
+   for (long long n : worker_rays) stats.rays += n;
+
+   if (!counts.empty())
+   {
+      int min_samples = settings.adaptive ? settings.min_samples : settings.samples_per_pixel;
+      int max_samples = settings.adaptive ? settings.max_samples : settings.samples_per_pixel;
+      save_sample_heatmap(counts, width, height, min_samples, max_samples, settings.heatmap_file);
+   }
+
+   print_render_stats(stats, width, height);
+   return stats;
+}
+
+#endif
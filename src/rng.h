@@ -0,0 +1,67 @@
+// rng.h
+// Small-state random number generator for sampling.
+// PCG32 (O'Neill, https://www.pcg-random.org) whose state and stream are derived by
+// hashing a (pixel, sample, bounce) key, so a path draws the same numbers no matter
+// which thread renders it or in which order the pixels are visited.
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+class rng {
+public:
+   rng(uint32_t pixel = 0, uint32_t sample = 0, uint32_t bounce = 0) { seed(pixel, sample, bounce); }
+
+   void seed(uint32_t pixel, uint32_t sample, uint32_t bounce = 0) {
+      key_pixel = pixel;
+      key_sample = sample;
+      uint64_t key = ((uint64_t) pixel << 32) | sample;
+      uint64_t stream = mix(bounce + 0x9e3779b97f4a7c15ull);
+      inc = (stream << 1) | 1u;
+      state = 0;
+      next_uint();
+      state += mix(key ^ stream);
+      next_uint();
+   }
+
+   // restart on the stream of another bounce of the same pixel sample
+   void start_bounce(uint32_t bounce) { seed(key_pixel, key_sample, bounce); }
+
+   uint32_t pixel() const { return key_pixel; }
+   uint32_t sample() const { return key_sample; }
+
+   uint32_t next_uint() {
+      uint64_t old = state;
+      state = old * 6364136223846793005ull + inc;
+      uint32_t xorshifted = (uint32_t) (((old >> 18u) ^ old) >> 27u);
+      uint32_t rot = (uint32_t) (old >> 59u);
+      return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+   }
+
+   // uniform in [0, 1)
+   float next_float() {
+      return (next_uint() >> 8) * (1.0f / 16777216.0f);
+   }
+
+   // uniform in [min, max)
+   float next_float(float min, float max) {
+      return min + (max - min) * next_float();
+   }
+
+private:
+   // splitmix64 finalizer
+   static uint64_t mix(uint64_t z) {
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      return z ^ (z >> 31);
+   }
+
+private:
+   uint64_t state;
+   uint64_t inc;
+   uint32_t key_pixel;
+   uint32_t key_sample;
+};
+
+#endif
@@ -0,0 +1,210 @@
+// sampler.h
+// Sample values for the dimensions of a path. The camera uses bounce 0 (pixel
+// position, lens, time) and every bounce after that gets its own dimensions, so a
+// value is identified by (pixel, sample index, bounce, dimension).
+//
+//  - independent: every value comes from rng, as before samplers were added
+//  - sobol: each (pixel, dimension) gets its own shuffled and Owen-scrambled 2D Sobol
+//    sequence (Burley, "Practical Hash-based Owen Scrambling", 2020), so the samples
+//    of a pixel are stratified for every power of two and in every 2D projection
+//  - blue_noise: the same sequence ordered along a Morton curve over the image
+//    (Ahmed and Wonka, "Screen-Space Blue-Noise Diffusion of Monte Carlo Sampling
+//    Error via Hierarchical Ordering of Pixels", 2020), so neighbouring pixels also
+//    get complementary samples and the remaining error looks like blue noise.
+//    Works best with a power of two samples per pixel.
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "AGLM.h"
+#include "rng.h"
+#include <algorithm>
+#include <cstdint>
+
+enum class sampling_method { independent, sobol, blue_noise };
+
+class sampler {
+public:
+   // samples_per_pixel is only used by blue_noise, to size the Morton ordering
+   sampler(sampling_method m = sampling_method::sobol, int width = 1, int height = 1,
+      int samples_per_pixel = 1, uint32_t seed = 0) :
+      method(m), width(width), seed(seed), log2_spp(0), num_digits(0),
+      pixel_key(0), index(0), bounce(0), dim(0), morton_index(0)
+   {
+      while ((1 << log2_spp) < samples_per_pixel) log2_spp++;
+      int log2_res = 0;
+      while ((1 << log2_res) < std::max(width, height)) log2_res++;
+      num_digits = log2_res + (log2_spp + 1) / 2;
+   }
+
+   sampling_method get_method() const { return method; }
+
+   // start sample number sample_index of the pixel in column x, row y
+   void start_pixel_sample(int x, int y, int sample_index)
+   {
+      pixel_key = (uint32_t) (y * width + x);
+      index = (uint32_t) sample_index;
+      morton_index = (encode_morton2(x, y) << log2_spp) | index;
+      bounce = 0;
+      dim = 0;
+      if (method == sampling_method::independent) gen.seed(pixel_key, index, 0);
+   }
+
+   // move on to the dimensions of another bounce of the same path
+   void start_bounce(int b)
+   {
+      bounce = (uint32_t) b;
+      dim = 0;
+      if (method == sampling_method::independent) gen.start_bounce(bounce);
+   }
+
+   // uniform in [0, 1)
+   float get_1d()
+   {
+      if (method == sampling_method::independent) return gen.next_float();
+
+      uint32_t key = next_dimension();
+      uint32_t i = sample_index(key);
+      return to_float(owen_scramble(sobol_0(i), hash(key, 1)));
+   }
+
+   // uniform in [0, 1)^2, stratified as a pair
+   glm::vec2 get_2d()
+   {
+      if (method == sampling_method::independent)
+      {
+         float x = gen.next_float();
+         float y = gen.next_float();
+         return glm::vec2(x, y);
+      }
+
+      uint32_t key = next_dimension();
+      uint32_t i = sample_index(key);
+      return glm::vec2(to_float(owen_scramble(sobol_0(i), hash(key, 1))),
+         to_float(owen_scramble(sobol_1(i), hash(key, 2))));
+   }
+
+   // so the random_* routines of AGLM.h accept a sampler as their generator
+   float next_float() { return get_1d(); }
+   float next_float(float min, float max) { return min + (max - min) * get_1d(); }
+
+private:
+   // a key for the next dimension of the current bounce, also mixed with the pixel for sobol
+   uint32_t next_dimension()
+   {
+      uint32_t key = (bounce << 16) + dim++;
+      return method == sampling_method::sobol ? hash(key, hash(pixel_key, seed)) : hash(key, seed);
+   }
+
+   uint32_t sample_index(uint32_t key) const
+   {
+      // sobol: shuffle the pixel's samples differently for every dimension, which
+      // decorrelates the dimensions while keeping each one stratified
+      if (method == sampling_method::sobol) return owen_scramble(index, key);
+      return blue_noise_index(key);
+   }
+
+   // Permute the base-4 digits of the Morton index, each permutation chosen by the
+   // digits above it, so that the sequence is split over the pixels of every aligned
+   // 2^k x 2^k block in a different random order for each dimension.
+   uint32_t blue_noise_index(uint32_t key) const
+   {
+      static const uint8_t permutations[24][4] = {
+         {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1}, {0, 3, 2, 1}, {0, 3, 1, 2},
+         {1, 0, 2, 3}, {1, 0, 3, 2}, {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 2, 0}, {1, 3, 0, 2},
+         {2, 1, 0, 3}, {2, 1, 3, 0}, {2, 0, 1, 3}, {2, 0, 3, 1}, {2, 3, 0, 1}, {2, 3, 1, 0},
+         {3, 1, 2, 0}, {3, 1, 0, 2}, {3, 2, 1, 0}, {3, 2, 0, 1}, {3, 0, 2, 1}, {3, 0, 1, 2}};
+
+      // with an odd log2_spp the lowest digit only has one bit
+      int odd = log2_spp & 1;
+      uint64_t result = 0;
+      for (int d = num_digits - 1; d >= odd; d--)
+      {
+         int shift = 2 * d - odd;
+         int digit = (morton_index >> shift) & 3;
+         uint64_t higher = morton_index >> (shift + 2);
+         int p = (int) ((mix(higher ^ (0x55555555u * key)) >> 24) % 24);
+         result |= (uint64_t) permutations[p][digit] << shift;
+      }
+      if (odd)
+      {
+         result |= (morton_index & 1) ^ (mix((morton_index >> 1) ^ (0x55555555u * key)) & 1);
+      }
+      return (uint32_t) result;
+   }
+
+   // first two dimensions of the Sobol sequence; the first is the van der Corput sequence
+   static uint32_t sobol_0(uint32_t i) { return reverse_bits(i); }
+   static uint32_t sobol_1(uint32_t i)
+   {
+      uint32_t result = 0;
+      for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1)
+      {
+         if (i & 1) result ^= v;
+      }
+      return result;
+   }
+
+   // nested uniform scramble of the bits of x, hashing from the most significant bit down
+   static uint32_t owen_scramble(uint32_t x, uint32_t seed)
+   {
+      x = reverse_bits(x);
+      x += seed;
+      x ^= x * 0x6c50b47cu;
+      x ^= x * 0xb82f1e52u;
+      x ^= x * 0xc7afe638u;
+      x ^= x * 0x8d22f6e6u;
+      return reverse_bits(x);
+   }
+
+   static uint32_t reverse_bits(uint32_t x)
+   {
+      x = (x << 16) | (x >> 16);
+      x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+      x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+      x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+      x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+      return x;
+   }
+
+   static uint64_t encode_morton2(uint32_t x, uint32_t y) { return (spread_bits(y) << 1) | spread_bits(x); }
+   static uint64_t spread_bits(uint64_t v)
+   {
+      v &= 0xffffffffull;
+      v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+      v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+      v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+      v = (v | (v << 2)) & 0x3333333333333333ull;
+      v = (v | (v << 1)) & 0x5555555555555555ull;
+      return v;
+   }
+
+   static uint64_t mix(uint64_t v)
+   {
+      v ^= v >> 31;
+      v *= 0x7fb5d329728ea185ull;
+      v ^= v >> 27;
+      v *= 0x81dadef4bc2dd44dull;
+      v ^= v >> 33;
+      return v;
+   }
+   static uint32_t hash(uint32_t a, uint32_t b) { return (uint32_t) mix(((uint64_t) a << 32) | b); }
+
+   static float to_float(uint32_t x) { return (x >> 8) * (1.0f / 16777216.0f); }
+
+private:
+   sampling_method method;
+   int width;
+   uint32_t seed;
+   int log2_spp;
+   int num_digits; // base-4 digits in the Morton index of a sample
+   rng gen; // used by sampling_method::independent
+
+   uint32_t pixel_key;
+   uint32_t index;
+   uint32_t bounce;
+   uint32_t dim;
+   uint64_t morton_index;
+};
+
+#endif
@@ -0,0 +1,98 @@
+// sampling.h
+// Closed-form warps from a uniform point u of [0, 1)^2 to directions and disks.
+// Unlike rejection sampling each warp uses exactly two values, a fixed amount of
+// work and no loops or data-dependent branches, so stratified samples (see sampler.h)
+// stay stratified. The batch variants warp many paths at once and are written as
+// plain loops over arrays so the compiler can vectorize them.
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+// uniform direction on the unit sphere
+inline glm::vec3 sample_uniform_sphere(const glm::vec2& u)
+{
+   float z = 1.0f - 2.0f * u.x;
+   float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+   float phi = glm::two_pi<float>() * u.y;
+   return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+// uniform point on the unit disk (z = 0) with Shirley and Chiu's concentric mapping,
+// which maps the square to the disk with little distortion; the choice between the
+// two wedges is a select rather than a branch
+inline glm::vec3 sample_concentric_disk(const glm::vec2& u)
+{
+   float a = 2.0f * u.x - 1.0f;
+   float b = 2.0f * u.y - 1.0f;
+   bool horizontal = std::fabs(a) > std::fabs(b);
+   float r = horizontal ? a : b;
+   float num = horizontal ? b : a;
+   float den = r != 0.0f ? r : 1.0f;
+   float phi = horizontal ? glm::quarter_pi<float>() * (num / den) :
+      glm::half_pi<float>() - glm::quarter_pi<float>() * (num / den);
+   return glm::vec3(r * std::cos(phi), r * std::sin(phi), 0.0f);
+}
+
+// cosine-weighted direction around +z (Malley's method: lift a disk sample to the
+// hemisphere), pdf = cos(theta) / pi
+inline glm::vec3 sample_cosine_hemisphere(const glm::vec2& u)
+{
+   glm::vec3 d = sample_concentric_disk(u);
+   d.z = std::sqrt(std::max(0.0f, 1.0f - d.x * d.x - d.y * d.y));
+   return d;
+}
+
+// build an orthonormal basis (t, b, n) around the unit vector n
+// from Duff et al., "Building an Orthonormal Basis, Revisited", 2017
+inline void build_onb(const glm::vec3& n, glm::vec3& t, glm::vec3& b)
+{
+   float sign = std::copysign(1.0f, n.z);
+   float a = -1.0f / (sign + n.z);
+   float c = n.x * n.y * a;
+   t = glm::vec3(1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+   b = glm::vec3(c, sign + n.y * n.y * a, -n.y);
+}
+
+// cosine-weighted unit direction around the unit normal n
+inline glm::vec3 sample_cosine_direction(const glm::vec3& n, const glm::vec2& u)
+{
+   glm::vec3 d = sample_cosine_hemisphere(u);
+   glm::vec3 t, b;
+   build_onb(n, t, b);
+   return d.x * t + d.y * b + d.z * n;
+}
+
+inline float cosine_hemisphere_pdf(float cos_theta)
+{
+   return std::max(0.0f, cos_theta) * glm::one_over_pi<float>();
+}
+
+// batch variants: out[k] is the warp of u[k]
+
+inline void sample_uniform_sphere(const glm::vec2* u, glm::vec3* out, int count)
+{
+   for (int k = 0; k < count; k++) out[k] = sample_uniform_sphere(u[k]);
+}
+
+inline void sample_concentric_disk(const glm::vec2* u, glm::vec3* out, int count)
+{
+   for (int k = 0; k < count; k++) out[k] = sample_concentric_disk(u[k]);
+}
+
+inline void sample_cosine_hemisphere(const glm::vec2* u, glm::vec3* out, int count)
+{
+   for (int k = 0; k < count; k++) out[k] = sample_cosine_hemisphere(u[k]);
+}
+
+// one direction around each normal n[k]
+inline void sample_cosine_direction(const glm::vec3* n, const glm::vec2* u, glm::vec3* out, int count)
+{
+   for (int k = 0; k < count; k++) out[k] = sample_cosine_direction(n[k], u[k]);
+}
+
+#endif
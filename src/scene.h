@@ -0,0 +1,159 @@
+// scene.h
+// A scene owns its objects and materials. Objects are allocated from an arena,
+// a few large blocks freed together with the scene, instead of one make_shared
+// each. Materials live in a table, and hit records refer to them by a 32-bit
+// index, so intersection and traversal never touch a reference count. The
+// hierarchy built over the objects calls the built-in primitives without virtual
+// calls (primitive_bvh.h). Geometry made with create() and placed with instances
+// (instance.h) is stored once however many times it appears.
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "primitive_bvh.h"
+#include "instance.h"
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// the materials of a scene, indexed by hit_record::mat_id
+class material_table {
+public:
+   // index of m, added to the table if it is not there yet
+   uint32_t add(const shared_ptr<material>& m) {
+      auto found = ids.find(m.get());
+      if (found != ids.end()) return found->second;
+      uint32_t id = (uint32_t) materials.size();
+      ids.emplace(m.get(), id);
+      materials.push_back(m);
+      return id;
+   }
+
+   const material& operator[](uint32_t id) const { return *materials[id]; }
+   size_t size() const { return materials.size(); }
+
+private:
+   std::vector<shared_ptr<material>> materials;
+   std::unordered_map<const material*, uint32_t> ids; // index of each material in materials
+};
+
+// Bump allocator for scene objects. Objects are constructed in place in large
+// blocks and destroyed, in reverse order, when the arena goes away.
+class object_arena {
+public:
+   explicit object_arena(size_t block_size = 1 << 16) : block_size(block_size), used(block_size) {}
+   object_arena(const object_arena&) = delete;
+   object_arena& operator=(const object_arena&) = delete;
+
+   ~object_arena() {
+      for (size_t k = destructors.size(); k > 0; k--)
+      {
+         destructors[k - 1].second(destructors[k - 1].first);
+      }
+   }
+
+   template <class T, class... Args>
+   T* create(Args&&... args) {
+      T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      destructors.push_back(std::make_pair((void*) object, &destroy<T>));
+      return object;
+   }
+
+private:
+   void* allocate(size_t size, size_t align) {
+      size_t offset = (used + align - 1) & ~(align - 1);
+      if (blocks.empty() || offset + size > block_size)
+      {
+         blocks.push_back(std::unique_ptr<char[]>(new char[std::max(block_size, size + align)]));
+         offset = (align - (reinterpret_cast<uintptr_t>(blocks.back().get()) & (align - 1))) & (align - 1);
+      }
+      used = offset + size;
+      return blocks.back().get() + offset;
+   }
+
+   template <class T>
+   static void destroy(void* object) { static_cast<T*>(object)->~T(); }
+
+private:
+   size_t block_size;
+   size_t used; // bytes used in the last block
+   std::vector<std::unique_ptr<char[]>> blocks;
+   std::vector<std::pair<void*, void (*)(void*)>> destructors;
+};
+
+class scene : public hittable {
+public:
+   scene() {}
+   scene(const scene&) = delete;
+   scene& operator=(const scene&) = delete;
+
+   uint32_t add_material(const shared_ptr<material>& m) { return materials.add(m); }
+
+   // construct an object of type T in the scene, e.g. add<sphere>(center, radius, mat_id)
+   template <class T, class... Args>
+   T* add(Args&&... args) {
+      T* object = arena.create<T>(std::forward<Args>(args)...);
+      // the arena owns the object: the pointer in the list has no control block
+      objects.add(shared_ptr<hittable>(shared_ptr<hittable>(), object));
+      accel.add(object); // sorted by type at compile time, see primitive_bvh
+      return object;
+   }
+
+   // construct an object owned by the scene but not part of it, e.g. geometry
+   // that is placed in the scene with instances (instance.h)
+   template <class T, class... Args>
+   T* create(Args&&... args) {
+      return arena.create<T>(std::forward<Args>(args)...);
+   }
+
+   // build the BVH over the objects added so far, for shutter times [time0, time1];
+   // objects changed after this need another build(). Then wait for the textures
+   // that were decoding in the background meanwhile (texture_cache.h).
+   void build(float time0 = 0.0f, float time1 = 0.0f) {
+      accel.build(time0, time1);
+      texture_cache::global().wait();
+      built = true;
+   }
+
+   // refit the BVH after objects have moved or instances were given a new transform,
+   // e.g. between the frames of an animation, keeping the shutter times of build();
+   // see primitive_bvh::update()
+   void update() {
+      accel.update();
+      built = true;
+   }
+
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override {
+      if (built) return accel.intersect(r, t_min, t_max, rec);
+      return objects.intersect(r, t_min, t_max, rec);
+   }
+
+   virtual void intersect_packet(ray_packet& packet, int first, int last) const override {
+      if (built) accel.intersect_packet(packet, first, last);
+      else objects.intersect_packet(packet, first, last);
+   }
+
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override {
+      return objects.bounding_box(time0, time1, output_box);
+   }
+
+   const material& material_of(const hit_record& rec) const { return materials[rec.mat_id]; }
+
+public:
+   material_table materials;
+   hittable_list objects; // every object, in the order they were added
+
+private:
+   object_arena arena;
+   primitive_bvh accel;
+   bool built = false;
+};
+
+#endif
@@ -0,0 +1,199 @@
+// simd.h
+// Thin wrappers over the widest float vector the compiler targets, so that
+// kernels can be written once for SSE (4 lanes), AVX/AVX2 (8) or AVX-512 (16).
+// The width follows the compiler flags (e.g. -mavx2 or -march=native with gcc and
+// clang, /arch:AVX2 with MSVC); without any of them the code runs one lane at a time.
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX512F__)
+#define SIMD_AVX512
+#include <immintrin.h>
+#elif defined(__AVX__)
+#define SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+namespace simd {
+
+#if defined(SIMD_AVX512)
+
+const int width = 16;
+const char* const name = "avx512";
+
+struct vmask { __mmask16 m; };
+struct vfloat {
+   vfloat() {}
+   vfloat(__m512 x) : v(x) {}
+   vfloat(float x) : v(_mm512_set1_ps(x)) {}
+   __m512 v;
+};
+
+inline vfloat load(const float* p) { return _mm512_loadu_ps(p); }
+inline void store(float* p, vfloat a) { _mm512_storeu_ps(p, a.v); }
+inline vfloat operator+(vfloat a, vfloat b) { return _mm512_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm512_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm512_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm512_div_ps(a.v, b.v); }
+inline vfloat sqrt(vfloat a) { return _mm512_sqrt_ps(a.v); }
+inline vfloat min(vfloat a, vfloat b) { return _mm512_min_ps(a.v, b.v); }
+inline vfloat max(vfloat a, vfloat b) { return _mm512_max_ps(a.v, b.v); }
+
+inline vmask operator<(vfloat a, vfloat b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+inline vmask operator>(vfloat a, vfloat b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+inline vmask operator<=(vfloat a, vfloat b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ) }; }
+inline vmask operator>=(vfloat a, vfloat b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; }
+inline vmask operator==(vfloat a, vfloat b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_EQ_OQ) }; }
+inline vmask operator!=(vfloat a, vfloat b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_NEQ_UQ) }; }
+inline vmask operator&(vmask a, vmask b) { return { (__mmask16) (a.m & b.m) }; }
+inline vmask operator|(vmask a, vmask b) { return { (__mmask16) (a.m | b.m) }; }
+inline vmask andnot(vmask a, vmask b) { return { (__mmask16) (~a.m & b.m) }; } // b and not a
+inline int bits(vmask a) { return a.m; }
+
+// a where mask is set, else b
+inline vfloat select(vmask mask, vfloat a, vfloat b) { return _mm512_mask_blend_ps(mask.m, b.v, a.v); }
+inline float reduce_min(vfloat a) { return _mm512_reduce_min_ps(a.v); }
+
+#elif defined(SIMD_AVX)
+
+const int width = 8;
+const char* const name = "avx";
+
+struct vmask { __m256 m; };
+struct vfloat {
+   vfloat() {}
+   vfloat(__m256 x) : v(x) {}
+   vfloat(float x) : v(_mm256_set1_ps(x)) {}
+   __m256 v;
+};
+
+inline vfloat load(const float* p) { return _mm256_loadu_ps(p); }
+inline void store(float* p, vfloat a) { _mm256_storeu_ps(p, a.v); }
+inline vfloat operator+(vfloat a, vfloat b) { return _mm256_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm256_div_ps(a.v, b.v); }
+inline vfloat sqrt(vfloat a) { return _mm256_sqrt_ps(a.v); }
+inline vfloat min(vfloat a, vfloat b) { return _mm256_min_ps(a.v, b.v); }
+inline vfloat max(vfloat a, vfloat b) { return _mm256_max_ps(a.v, b.v); }
+
+inline vmask operator<(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline vmask operator>(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline vmask operator<=(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline vmask operator>=(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline vmask operator==(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+inline vmask operator!=(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ) }; }
+inline vmask operator&(vmask a, vmask b) { return { _mm256_and_ps(a.m, b.m) }; }
+inline vmask operator|(vmask a, vmask b) { return { _mm256_or_ps(a.m, b.m) }; }
+inline vmask andnot(vmask a, vmask b) { return { _mm256_andnot_ps(a.m, b.m) }; } // b and not a
+inline int bits(vmask a) { return _mm256_movemask_ps(a.m); }
+
+// a where mask is set, else b
+inline vfloat select(vmask mask, vfloat a, vfloat b) { return _mm256_blendv_ps(b.v, a.v, mask.m); }
+inline float reduce_min(vfloat a) {
+   __m128 m = _mm_min_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+   m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+   m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+   return _mm_cvtss_f32(m);
+}
+
+#elif defined(SIMD_SSE)
+
+const int width = 4;
+const char* const name = "sse";
+
+struct vmask { __m128 m; };
+struct vfloat {
+   vfloat() {}
+   vfloat(__m128 x) : v(x) {}
+   vfloat(float x) : v(_mm_set1_ps(x)) {}
+   __m128 v;
+};
+
+inline vfloat load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, vfloat a) { _mm_storeu_ps(p, a.v); }
+inline vfloat operator+(vfloat a, vfloat b) { return _mm_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm_div_ps(a.v, b.v); }
+inline vfloat sqrt(vfloat a) { return _mm_sqrt_ps(a.v); }
+inline vfloat min(vfloat a, vfloat b) { return _mm_min_ps(a.v, b.v); }
+inline vfloat max(vfloat a, vfloat b) { return _mm_max_ps(a.v, b.v); }
+
+inline vmask operator<(vfloat a, vfloat b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline vmask operator>(vfloat a, vfloat b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline vmask operator<=(vfloat a, vfloat b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline vmask operator>=(vfloat a, vfloat b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline vmask operator==(vfloat a, vfloat b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+inline vmask operator!=(vfloat a, vfloat b) { return { _mm_cmpneq_ps(a.v, b.v) }; }
+inline vmask operator&(vmask a, vmask b) { return { _mm_and_ps(a.m, b.m) }; }
+inline vmask operator|(vmask a, vmask b) { return { _mm_or_ps(a.m, b.m) }; }
+inline vmask andnot(vmask a, vmask b) { return { _mm_andnot_ps(a.m, b.m) }; } // b and not a
+inline int bits(vmask a) { return _mm_movemask_ps(a.m); }
+
+// a where mask is set, else b
+inline vfloat select(vmask mask, vfloat a, vfloat b) {
+   return _mm_or_ps(_mm_and_ps(mask.m, a.v), _mm_andnot_ps(mask.m, b.v));
+}
+inline float reduce_min(vfloat a) {
+   __m128 m = _mm_min_ps(a.v, _mm_movehl_ps(a.v, a.v));
+   m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+   return _mm_cvtss_f32(m);
+}
+
+#else
+
+const int width = 1;
+const char* const name = "scalar";
+
+struct vmask { bool m; };
+struct vfloat {
+   vfloat() {}
+   vfloat(float x) : v(x) {}
+   float v;
+};
+
+inline vfloat load(const float* p) { return *p; }
+inline void store(float* p, vfloat a) { *p = a.v; }
+inline vfloat operator+(vfloat a, vfloat b) { return a.v + b.v; }
+inline vfloat operator-(vfloat a, vfloat b) { return a.v - b.v; }
+inline vfloat operator*(vfloat a, vfloat b) { return a.v * b.v; }
+inline vfloat operator/(vfloat a, vfloat b) { return a.v / b.v; }
+inline vfloat sqrt(vfloat a) { return std::sqrt(a.v); }
+inline vfloat min(vfloat a, vfloat b) { return b.v < a.v ? b.v : a.v; }
+inline vfloat max(vfloat a, vfloat b) { return b.v > a.v ? b.v : a.v; }
+
+inline vmask operator<(vfloat a, vfloat b) { return { a.v < b.v }; }
+inline vmask operator>(vfloat a, vfloat b) { return { a.v > b.v }; }
+inline vmask operator<=(vfloat a, vfloat b) { return { a.v <= b.v }; }
+inline vmask operator>=(vfloat a, vfloat b) { return { a.v >= b.v }; }
+inline vmask operator==(vfloat a, vfloat b) { return { a.v == b.v }; }
+inline vmask operator!=(vfloat a, vfloat b) { return { a.v != b.v }; }
+inline vmask operator&(vmask a, vmask b) { return { a.m && b.m }; }
+inline vmask operator|(vmask a, vmask b) { return { a.m || b.m }; }
+inline vmask andnot(vmask a, vmask b) { return { !a.m && b.m }; } // b and not a
+inline int bits(vmask a) { return a.m ? 1 : 0; }
+
+// a where mask is set, else b
+inline vfloat select(vmask mask, vfloat a, vfloat b) { return mask.m ? a : b; }
+inline float reduce_min(vfloat a) { return a.v; }
+
+#endif
+
+// index of the lowest set bit of a nonzero lane mask
+inline int first_lane(int mask_bits) {
+   int lane = 0;
+   while (!(mask_bits & 1)) { mask_bits >>= 1; lane++; }
+   return lane;
+}
+
+} // namespace simd
+
+#endif
@@ -8,19 +8,23 @@
 
 class sphere : public hittable {
 public:
-   sphere() : radius(0), center(0), mat_ptr(0) {}
-   sphere(const glm::point3& cen, float r, std::shared_ptr<material> m) : 
-      center(cen), radius(r), mat_ptr(m) {};
+   sphere() : radius(0), center(0), mat_id(0) {}
+   sphere(const glm::point3& cen, float r, uint32_t m) : 
+      center(cen), radius(r), mat_id(m) {};
 
-   virtual bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const override;
-   
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override;
+   virtual void finalize_hit(const ray& r, hit_record& rec) const override;
+   virtual void surface_differential(const ray& r, const hit_record& rec, const glm::vec3& dp, glm::vec3& dn, glm::vec2& duv) const override;
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override;
+   virtual float pdf_value(const glm::point3& origin, const glm::vec3& direction) const override;
+   virtual glm::vec3 random(const glm::point3& origin, sampler& gen) const override;
 
 public:
    glm::point3 center;
    float radius;
-   std::shared_ptr<material> mat_ptr;
+   uint32_t mat_id; // index into the scene's material_table
 
-private:
+    // texture coordinates of the point p on the unit sphere, also used by sphere_set
     static void get_uv_coordinates(const glm::point3& p, float& u, float& v) {
         const float pi = glm::pi<float>();
         float theta = acos(-p.y);
@@ -28,10 +32,16 @@ private:
         u = phi / (2 * pi);
         v = theta / pi;
     }
+
+    // change of the texture coordinates at the unit normal n when it changes by dn
+    static glm::vec2 get_uv_differential(const glm::vec3& n, const glm::vec3& dn) {
+        const float pi = glm::pi<float>();
+        float axis_dist2 = std::max(n.x * n.x + n.z * n.z, 1e-8f); // squared distance from the y axis
+        return glm::vec2((n.z * dn.x - n.x * dn.z) / (2 * pi * axis_dist2), dn.y / (pi * std::sqrt(axis_dist2)));
+    }
 };
 
-bool sphere::hit(const ray& r, float t_min, float t_max, hit_record& rec) const {
-    float t = 0;
+inline bool sphere::intersect(const ray& r, float t_min, float t_max, hit_record& rec) const {
     float length = glm::length(r.direction());
     glm::vec3 el = center - r.origin();
     glm::vec3 unitDirection = r.direction() / length;
@@ -46,24 +56,74 @@ bool sphere::hit(const ray& r, float t_min, float t_max, hit_record& rec) const
     if (mSqr > rSqr)
         return false;
 
+    // the nearer intersection if it is in [t_min, t_max], else the farther one
     float q = sqrt(rSqr - mSqr);
-    if (elSqr > rSqr)
-        t = s - q;
-    else
-        t = s + q;
+    float t = (s - q) / length;
+    if (t < t_min || t_max < t) {
+        t = (s + q) / length;
+        if (t < t_min || t_max < t)
+            return false;
+    }
 
-    // save relevant data in hit record
-    rec.t = t / length; // save the time when we hit the object
-    rec.p = r.at(t / length); // ray.origin + t * ray.direction
-    rec.mat_ptr = mat_ptr;
+    rec.t = t; // save the time when we hit the object
+    rec.mat_id = mat_id;
+    rec.object = this;
+    return true;
+}
+
+inline void sphere::finalize_hit(const ray& r, hit_record& rec) const {
+    rec.p = r.at(rec.t); // ray.origin + t * ray.direction
 
     // save normal
     glm::vec3 outward_normal = normalize(rec.p - center); // compute unit length normal
     rec.set_face_normal(r, outward_normal);
     get_uv_coordinates(outward_normal, rec.u, rec.v);
+}
 
+// the normal turns by dp / radius, without trigonometry
+inline void sphere::surface_differential(const ray& r, const hit_record& rec, const glm::vec3& dp, glm::vec3& dn, glm::vec2& duv) const {
+    glm::vec3 outward_normal = rec.front_face ? rec.normal : -rec.normal;
+    glm::vec3 outward_dn = dp / std::fabs(radius);
+    dn = rec.front_face ? outward_dn : -outward_dn;
+    duv = get_uv_differential(outward_normal, outward_dn);
+}
+inline bool sphere::bounding_box(float time0, float time1, aabb& output_box) const {
+    glm::vec3 extent(fabs(radius));
+    output_box = aabb(center - extent, center + extent);
     return true;
 }
+
+// directions towards the sphere are sampled uniformly inside the cone it subtends from origin
+inline float sphere::pdf_value(const glm::point3& origin, const glm::vec3& direction) const {
+    glm::vec3 to_center = center - origin;
+    float dist_squared = glm::dot(to_center, to_center);
+    if (dist_squared <= radius * radius) return 0; // origin inside the sphere
+
+    float cos_theta_max = std::sqrt(1 - radius * radius / dist_squared);
+    float cos_theta = glm::dot(to_center, direction) / std::sqrt(dist_squared * glm::dot(direction, direction));
+    if (cos_theta < cos_theta_max) return 0; // direction misses the sphere
+
+    float solid_angle = 2 * pi * (1 - cos_theta_max);
+    return 1 / solid_angle;
+}
+
+inline glm::vec3 sphere::random(const glm::point3& origin, sampler& gen) const {
+    glm::vec3 to_center = center - origin;
+    float dist_squared = glm::dot(to_center, to_center);
+    if (dist_squared <= radius * radius) return to_center;
+
+    float cos_theta_max = std::sqrt(1 - radius * radius / dist_squared);
+    glm::vec2 u2 = gen.get_2d();
+    float z = 1 + u2.x * (cos_theta_max - 1);
+    float phi = 2 * pi * u2.y;
+    float sin_theta = std::sqrt(std::max(0.0f, 1 - z * z));
+
+    glm::vec3 w = to_center / std::sqrt(dist_squared);
+    glm::vec3 u, v;
+    build_onb(w, u, v);
+    return std::cos(phi) * sin_theta * u + std::sin(phi) * sin_theta * v + z * w;
+}
+
 //analytical approach
 //bool sphere::hit(const ray& r, hit_record& rec) const {
 //   glm::vec3 oc = r.origin() - center;
@@ -82,7 +142,7 @@ bool sphere::hit(const ray& r, float t_min, float t_max, hit_record& rec) const
 //   // save relevant data in hit record
 //   rec.t = t; // save the time when we hit the object
 //   rec.p = r.at(t); // ray.origin + t * ray.direction
-//   rec.mat_ptr = mat_ptr; 
+//   rec.mat_id = mat_id; 
 //
 //   // save normal
 //   glm::vec3 outward_normal = normalize(rec.p - center); // compute unit length normal
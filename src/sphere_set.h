@@ -0,0 +1,146 @@
+// sphere_set.h
+// Many spheres stored as a single hittable, with their centers and radii in
+// separate arrays, so that one ray is tested against simd::width spheres at once
+// (simd.h) instead of one sphere per virtual call. Hits are the same as a
+// hittable_list of the same spheres, up to float rounding.
+//
+// A sphere_set is a single leaf for hittable_list and bvh_node, with the box of all
+// its spheres: use one set per cluster of nearby spheres. Spheres in a set are not
+// sampled as lights by light_list, so keep emitting spheres as separate objects.
+
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "hittable.h"
+#include "sphere.h"
+#include "simd.h"
+#include "AGLM.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+class sphere_set : public hittable {
+public:
+   sphere_set() : count(0) {}
+
+   void add(const glm::point3& center, float radius, uint32_t mat_id) {
+      // fill the next padding lane, or add a whole block of padding
+      if (count == (int) cx.size())
+      {
+         // padding spheres have NaN centers, which fail every comparison
+         const float nan = std::numeric_limits<float>::quiet_NaN();
+         cx.resize(cx.size() + block, nan);
+         cy.resize(cy.size() + block, nan);
+         cz.resize(cz.size() + block, nan);
+         radius2.resize(radius2.size() + block, 0.0f);
+      }
+      cx[count] = center.x;
+      cy[count] = center.y;
+      cz[count] = center.z;
+      radius2[count] = radius * radius;
+      radii.push_back(radius);
+      mat_ids.push_back(mat_id);
+      count++;
+   }
+
+   int size() const { return count; }
+   glm::point3 center(int k) const { return glm::point3(cx[k], cy[k], cz[k]); }
+   float radius(int k) const { return radii[k]; }
+
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override;
+   virtual void finalize_hit(const ray& r, hit_record& rec) const override;
+   virtual void surface_differential(const ray& r, const hit_record& rec, const glm::vec3& dp, glm::vec3& dn, glm::vec2& duv) const override;
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override;
+
+   // arrays are padded to a multiple of this, the widest simd::width
+   static const int block = 16;
+
+private:
+   // structure of arrays, padded to a multiple of block
+   std::vector<float> cx, cy, cz;
+   std::vector<float> radius2;
+   // per sphere, not padded
+   std::vector<float> radii;
+   std::vector<uint32_t> mat_ids;
+   int count;
+};
+
+// the same tests as sphere::intersect, simd::width spheres at a time
+inline bool sphere_set::intersect(const ray& r, float t_min, float t_max, hit_record& rec) const {
+   using namespace simd;
+
+   float length = glm::length(r.direction());
+   glm::vec3 unitDirection = r.direction() / length;
+   vfloat ox(r.origin().x), oy(r.origin().y), oz(r.origin().z);
+   vfloat ux(unitDirection.x), uy(unitDirection.y), uz(unitDirection.z);
+   vfloat len(length), lo(t_min), zero(0.0f);
+   const vfloat inf(infinity);
+
+   int best = -1;
+   float closest_so_far = t_max;
+   for (int k = 0; k < count; k += width)
+   {
+      vfloat hi(closest_so_far);
+      vfloat elx = load(&cx[k]) - ox;
+      vfloat ely = load(&cy[k]) - oy;
+      vfloat elz = load(&cz[k]) - oz;
+      vfloat s = elx * ux + ely * uy + elz * uz;
+      vfloat elSqr = elx * elx + ely * ely + elz * elz;
+      vfloat rSqr = load(&radius2[k]);
+      vfloat mSqr = elSqr - s * s;
+
+      // behind the origin, or the line misses the sphere
+      vmask miss = ((s < zero) & (elSqr > rSqr)) | (mSqr > rSqr);
+
+      // the nearer intersection if it is in [t_min, t_max], else the farther one
+      vfloat q = sqrt(rSqr - mSqr);
+      vfloat t0 = (s - q) / len;
+      vfloat t1 = (s + q) / len;
+      vmask near_ok = (t0 >= lo) & (t0 <= hi);
+      vmask far_ok = (t1 >= lo) & (t1 <= hi);
+      vfloat t = select(near_ok, t0, t1);
+      vmask found = andnot(miss, near_ok | far_ok);
+      if (!bits(found)) continue;
+
+      t = select(found, t, inf);
+      float t_block = reduce_min(t);
+      best = k + first_lane(bits(found & (t == vfloat(t_block))));
+      closest_so_far = t_block;
+   }
+
+   if (best < 0) return false;
+   rec.t = closest_so_far;
+   rec.mat_id = mat_ids[best];
+   rec.object = this;
+   rec.prim = (uint32_t) best;
+   return true;
+}
+
+inline void sphere_set::finalize_hit(const ray& r, hit_record& rec) const {
+   rec.p = r.at(rec.t);
+   glm::vec3 outward_normal = glm::normalize(rec.p - center(rec.prim));
+   rec.set_face_normal(r, outward_normal);
+   sphere::get_uv_coordinates(outward_normal, rec.u, rec.v);
+}
+
+inline void sphere_set::surface_differential(const ray& r, const hit_record& rec, const glm::vec3& dp, glm::vec3& dn, glm::vec2& duv) const {
+   glm::vec3 outward_normal = rec.front_face ? rec.normal : -rec.normal;
+   glm::vec3 outward_dn = dp / std::fabs(radius(rec.prim));
+   dn = rec.front_face ? outward_dn : -outward_dn;
+   duv = sphere::get_uv_differential(outward_normal, outward_dn);
+}
+
+inline bool sphere_set::bounding_box(float time0, float time1, aabb& output_box) const {
+   if (count == 0) return false;
+   output_box = aabb();
+   for (int k = 0; k < count; k++)
+   {
+      glm::vec3 extent(std::fabs(radii[k]));
+      aabb box(center(k) - extent, center(k) + extent);
+      output_box = k == 0 ? box : surrounding_box(output_box, box);
+   }
+   return true;
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include "ray.h"
 #include "hittable.h"
 #include "hittable_list.h"
+#include "texture_cache.h"
 #include <cassert>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
@@ -15,6 +16,13 @@
 class texture {
 public:
 	virtual glm::color value(double u, double v, const glm::point3& p) const = 0;
+
+	// value filtered over the footprint of a pixel, given by the derivatives of (u, v)
+	// across it in x and y; textures without filtering ignore them
+	virtual glm::color value(double u, double v, const glm::point3& p, const glm::vec2& duvdx, const glm::vec2& duvdy) const {
+		return value(u, v, p);
+	}
+	virtual ~texture() {}
 };
 
 //this class is responsible for returning the color(no textures is applied)
@@ -53,61 +61,67 @@ public:
 			return even->value(u, v, p);
 	}
 
+	virtual glm::color value(double u, double v, const glm::point3& p, const glm::vec2& duvdx, const glm::vec2& duvdy) const
+	{
+		float sines = sin(10 * p.x) * sin(10 * p.y) * sin(10 * p.z);
+		if (sines < 0)
+			return odd->value(u, v, p, duvdx, duvdy);
+		else
+			return even->value(u, v, p, duvdx, duvdy);
+	}
+
 public:
 	shared_ptr<texture> odd;
 	shared_ptr<texture> even;
 };
 
+// An image, with its mip chain in tiles (mipmap.h). Plain lookups are bilinear in
+// the full image; lookups with a footprint are trilinear. Images from files are
+// loaded on their first lookup and shared through the texture_cache.
 class image_texture : public texture 
 {
 public:
-    const static int bytes_per_pixel = 3;
+    image_texture() : cache(nullptr) {}
 
-    image_texture()
-        : data(nullptr), width(0), height(0), bytes_per_scanline(0) {}
+    // format picks how the texels are kept in memory (mipmap.h): unorm8 by default,
+    // srgb8 for images in sRGB, half for HDR images, bc1 for an eighth of the memory
+    image_texture(const char* filename, texel_format format = texel_format::unorm8,
+        texture_cache& cache = texture_cache::global())
+        : cache(&cache), file(cache.find(filename, format)) {}
 
-    image_texture(const char* filename) {
-        auto components_per_pixel = bytes_per_pixel;
+    // from 8-bit RGB pixels, row-major from the top row; kept outside the cache
+    image_texture(const unsigned char* rgb, int width, int height, texel_format format = texel_format::unorm8)
+        : cache(nullptr), owned(rgb, width, height, 3, format) {}
 
-        data = stbi_load(filename, &width, &height, &components_per_pixel, components_per_pixel);
-
-        if (!data) {
-            std::cerr << "ERROR: Could not load texture image file '" << filename << "'.\n";
-            width = height = 0;
-        }
-
-        bytes_per_scanline = bytes_per_pixel * width;
+    virtual glm::color value(double u, double v, const glm::vec3& p) const override {
+        return value(u, v, p, glm::vec2(0.0f), glm::vec2(0.0f));
     }
 
-    ~image_texture() {
-        delete data;
+    virtual glm::color value(double u, double v, const glm::point3& p, const glm::vec2& duvdx, const glm::vec2& duvdy) const override {
+        if (file)
+        {
+            texture_cache::lease texels = cache->acquire(*file);
+            return lookup(texels.get(), u, v, duvdx, duvdy);
+        }
+        return lookup(&owned, u, v, duvdx, duvdy);
     }
 
-    virtual glm::color value(double u, double v, const glm::vec3& p) const override {
-        if (data == nullptr)
+private:
+    static glm::color lookup(const mipmap* texels, double u, double v, const glm::vec2& duvdx, const glm::vec2& duvdy) {
+        if (!texels || texels->empty())
             return glm::color(0, 1, 1);
 
         // Clamp input texture coordinates to [0,1] x [1,0]
-        u = glm::clamp(u, 0.0, 1.0);
-        v = 1.0 - glm::clamp(v, 0.0, 1.0);  // Flip V to image coordinates
+        float s = glm::clamp(float(u), 0.0f, 1.0f);
+        float t = 1.0f - glm::clamp(float(v), 0.0f, 1.0f);  // Flip V to image coordinates
 
-        auto i = static_cast<int>(u * width);
-        auto j = static_cast<int>(v * height);
-
-        // Clamp integer mapping, since actual coordinates should be less than 1.0
-        if (i >= width)  i = width - 1;
-        if (j >= height) j = height - 1;
-
-        const auto color_scale = 1.0 / 255.0;
-        auto pixel = data + j * bytes_per_scanline + i * bytes_per_pixel;
-
-        return glm::color(color_scale * pixel[0], color_scale * pixel[1], color_scale * pixel[2]);
+        // flipping v does not change the size of the footprint
+        return texels->trilinear(s, t, duvdx, duvdy);
     }
 
-private:
-    unsigned char* data;
-    int width, height;
-    int bytes_per_scanline;
+    texture_cache* cache;
+    std::shared_ptr<texture_cache::entry> file; // for images from files
+    mipmap owned; // for images from memory
 };
 #endif
 
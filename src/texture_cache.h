@@ -0,0 +1,393 @@
+// texture_cache.h
+// Process-wide cache of the image files used as textures. An image_texture made
+// from a file only looks its path up here: the file is decoded into a mip chain
+// (mipmap.h) on the first lookup, so textures that are never seen are never
+// loaded, and textures made from the same path share one copy. Loaded textures
+// are kept under a memory budget. When a load would go over it, the textures
+// used least recently are dropped, and decoded again if they are needed later.
+//
+// Lookups from render threads take no lock unless they have to load the file.
+// They lease the texture for the time of the lookup, so it is not evicted under
+// them. A lease is announced in a slot that belongs to its thread (a hazard
+// pointer), so threads reading the same texture write nothing they share.
+// stb_image decodes whole files, so a texture is loaded and dropped as a whole
+// rather than tile by tile.
+//
+// By default, a texture is also queued for decoding in the background as soon as
+// its path is first seen, on one thread per core, so the images of a scene are
+// decoded in parallel while the rest of it is built. scene::build() waits for them.
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "mipmap.h"
+#include "thread_pool.h"
+#include "stb/stb_image.h" // declarations only; texture.h compiles the implementation
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class texture_cache {
+public:
+   // the cached texture of one file, in one texel format
+   class entry {
+   public:
+      const std::string& path() const { return file; }
+      texel_format format() const { return texels_format; }
+
+   private:
+      friend class texture_cache;
+      entry(const std::string& path, texel_format format) : file(path), texels_format(format), bytes(0), texels(nullptr), readers(0), last_use(0), failed(false) {}
+
+      std::string file;
+      texel_format texels_format;
+      size_t bytes; // memory of texels while resident, guarded by the cache's mutex
+      std::atomic<const mipmap*> texels; // null until loaded and after eviction
+      std::atomic<int> readers; // leases held on texels outside the threads' slots
+      std::atomic<uint64_t> last_use; // the cache's clock at the last lookup
+      std::atomic<bool> failed; // the file could not be read; it is not tried again
+      std::mutex loading; // held while the file is decoded
+   };
+
+   // The texels of an entry, kept from eviction while the lease is held. Leases are
+   // meant to be short, e.g. one texture lookup.
+   class lease {
+   public:
+      lease() : e(nullptr), slot(nullptr), texels(nullptr) {}
+      lease(lease&& other) : e(other.e), slot(other.slot), texels(other.texels) {
+         other.e = nullptr;
+         other.slot = nullptr;
+      }
+      lease& operator=(const lease&) = delete;
+      ~lease() {
+         if (slot) slot->store(nullptr, std::memory_order_release);
+         else if (e) e->readers.fetch_sub(1, std::memory_order_release);
+      }
+
+      // null if the file cannot be read
+      const mipmap* get() const { return texels; }
+
+   private:
+      friend class texture_cache;
+      lease(entry* e, const mipmap* texels) : e(e), slot(nullptr), texels(texels) {}
+      lease(std::atomic<const entry*>* slot, const mipmap* texels) : e(nullptr), slot(slot), texels(texels) {}
+
+      entry* e; // counted in e->readers
+      std::atomic<const entry*>* slot; // or announced in a thread's slot
+      const mipmap* texels;
+   };
+
+   explicit texture_cache(size_t budget_bytes = size_t(1) << 30)
+      : budget_bytes(budget_bytes), used_bytes(0), clock(0), load_count(0), eviction_count(0),
+      preloading(true), decoding(0), stopping(false) {}
+   texture_cache(const texture_cache&) = delete;
+   texture_cache& operator=(const texture_cache&) = delete;
+
+   ~texture_cache() {
+      {
+         std::lock_guard<std::mutex> guard(queue_mutex);
+         stopping = true;
+      }
+      queued.notify_all();
+      if (loader.joinable()) loader.join();
+      clear();
+   }
+
+   // the cache used by image_texture
+   static texture_cache& global() {
+      static texture_cache cache;
+      return cache;
+   }
+
+   // the entry of path stored in format, added if it is new and then queued for
+   // preload() unless preloading is off
+   std::shared_ptr<entry> find(const std::string& path, texel_format format = texel_format::unorm8) {
+      std::shared_ptr<entry> e;
+      bool added = false;
+      {
+         std::lock_guard<std::mutex> guard(mutex);
+         std::shared_ptr<entry>& slot = entries[std::make_pair(path, format)];
+         if (!slot)
+         {
+            slot = std::shared_ptr<entry>(new entry(path, format));
+            added = true;
+         }
+         e = slot;
+      }
+      if (added && preloading) preload(*e);
+      return e;
+   }
+
+   // true (the default): find() queues new textures for decoding in the background;
+   // false: textures are only decoded on their first lookup, e.g. for scenes with
+   // far more texture data than is ever seen
+   void set_preloading(bool on) { preloading = on; }
+
+   // Queue e for decoding on the loader threads and return at once. A lookup that
+   // needs e before it is done waits for it, or decodes it itself if it has not started.
+   void preload(entry& e) {
+      {
+         std::lock_guard<std::mutex> guard(queue_mutex);
+         if (!loader.joinable()) loader = std::thread(&texture_cache::loader_loop, this);
+         pending.push_back(&e);
+      }
+      queued.notify_one();
+   }
+
+   // block until every texture queued with preload() is decoded
+   void wait() {
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      drained.wait(lock, [this] { return pending.empty() && decoding == 0; });
+   }
+
+   // a lease on the texels of e, which are decoded first if they are not in memory
+   lease acquire(entry& e);
+
+   // Most bytes of texels to keep; evicts at once if more are loaded. Textures
+   // leased at the time cannot be evicted, so until the next load the cache can be
+   // over the budget by about one texture per render thread.
+   void set_budget(size_t bytes) {
+      std::lock_guard<std::mutex> guard(mutex);
+      budget_bytes = bytes;
+      make_room(0);
+   }
+
+   // evict every texture that is not leased, e.g. between scenes
+   void clear() {
+      std::lock_guard<std::mutex> guard(mutex);
+      std::vector<entry*> all(resident);
+      for (entry* e : all) evict(e);
+   }
+
+   size_t budget() const { std::lock_guard<std::mutex> guard(mutex); return budget_bytes; }
+   size_t resident_bytes() const { std::lock_guard<std::mutex> guard(mutex); return used_bytes; }
+   int loads() const { std::lock_guard<std::mutex> guard(mutex); return load_count; }
+   int evictions() const { std::lock_guard<std::mutex> guard(mutex); return eviction_count; }
+
+private:
+   // The entry a thread holds a lease on, if any, on a cache line of its own. The
+   // slots are shared by all caches and reused once their thread ends.
+   struct alignas(64) reader_slot {
+      reader_slot() : reading(nullptr), owned(false) {}
+      std::atomic<const entry*> reading;
+      std::atomic<bool> owned;
+   };
+   static const int max_reader_slots = 256;
+
+   static reader_slot* reader_slots() {
+      static reader_slot slots[max_reader_slots];
+      return slots;
+   }
+
+   // one past the last slot ever claimed
+   static std::atomic<int>& reader_slots_used() {
+      static std::atomic<int> used(0);
+      return used;
+   }
+
+   // the slot of the calling thread, claimed by its first lookup; null once every
+   // slot is taken, and those threads count their leases in entry::readers
+   static reader_slot* thread_slot() {
+      struct claim {
+         claim() : slot(nullptr) {
+            reader_slot* slots = reader_slots();
+            for (int k = 0; k < max_reader_slots && !slot; k++)
+            {
+               bool free = false;
+               if (slots[k].owned.compare_exchange_strong(free, true)) slot = &slots[k];
+            }
+            if (!slot) return;
+            int end = (int) (slot - slots) + 1;
+            int used = reader_slots_used().load();
+            while (used < end && !reader_slots_used().compare_exchange_weak(used, end)) {}
+         }
+         ~claim() { if (slot) slot->owned.store(false, std::memory_order_release); }
+         reader_slot* slot;
+      };
+      static thread_local claim mine;
+      return mine.slot;
+   }
+
+   // whether some thread announced a lease on e in its slot
+   static bool read_in_slot(const entry* e) {
+      reader_slot* slots = reader_slots();
+      int used = reader_slots_used().load();
+      for (int k = 0; k < used; k++)
+      {
+         if (slots[k].reading.load() == e) return true;
+      }
+      return false;
+   }
+
+   // acquire() for texels that are not in memory
+   lease load(entry& e);
+
+   // the mip chain of an image file, null if it cannot be read; HDR files are read
+   // as floats for the half format
+   static mipmap* decode(const std::string& path, texel_format format) {
+      int width, height, components_per_pixel;
+      if (format == texel_format::half && stbi_is_hdr(path.c_str()))
+      {
+         float* data = stbi_loadf(path.c_str(), &width, &height, &components_per_pixel, 3);
+         if (!data) return nullptr;
+         mipmap* texels = new mipmap(data, width, height, 3, format);
+         stbi_image_free(data);
+         return texels;
+      }
+      unsigned char* data = stbi_load(path.c_str(), &width, &height, &components_per_pixel, 3);
+      if (!data) return nullptr;
+      mipmap* texels = new mipmap(data, width, height, 3, format);
+      stbi_image_free(data);
+      return texels;
+   }
+
+   // Runs on its own thread while there are textures to preload, and decodes them
+   // in batches on a thread_pool, which spreads files of different sizes over the
+   // cores. The pool's threads sleep between batches.
+   void loader_loop() {
+      thread_pool pool;
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      while (true)
+      {
+         queued.wait(lock, [this] { return stopping || !pending.empty(); });
+         if (stopping) return;
+
+         std::vector<entry*> batch;
+         batch.swap(pending);
+         decoding = (int) batch.size();
+         lock.unlock();
+         pool.parallel_for((int) batch.size(), [&](int k, int worker)
+         {
+            load(*batch[k]);
+         });
+         lock.lock();
+         decoding = 0;
+         if (pending.empty()) drained.notify_all();
+      }
+   }
+
+   // evict the least recently used textures until bytes more fit in the budget
+   void make_room(size_t bytes) {
+      if (used_bytes + bytes <= budget_bytes) return;
+      std::vector<entry*> oldest_first(resident);
+      std::sort(oldest_first.begin(), oldest_first.end(), [](const entry* a, const entry* b)
+      {
+         return a->last_use.load(std::memory_order_relaxed) < b->last_use.load(std::memory_order_relaxed);
+      });
+      for (entry* e : oldest_first)
+      {
+         if (used_bytes + bytes <= budget_bytes) break;
+         evict(e);
+      }
+   }
+
+   // Take the texels away first and then look for leases: a lookup that leased the
+   // texels before they were taken is seen here, and they are put back; one that
+   // comes after finds them gone and waits for the mutex to load them again.
+   void evict(entry* e) {
+      const mipmap* texels = e->texels.exchange(nullptr);
+      if (e->readers.load() != 0 || read_in_slot(e))
+      {
+         e->texels.store(texels);
+         return;
+      }
+      delete texels;
+      used_bytes -= e->bytes;
+      e->bytes = 0;
+      resident.erase(std::find(resident.begin(), resident.end(), e));
+      eviction_count++;
+   }
+
+   mutable std::mutex mutex; // guards the members below and which entries are resident
+   std::map<std::pair<std::string, texel_format>, std::shared_ptr<entry>> entries;
+   std::vector<entry*> resident; // entries with texels in memory
+   size_t budget_bytes;
+   size_t used_bytes;
+   std::atomic<uint64_t> clock; // advanced by every load, so lookups since the last load count as equally recent
+   int load_count;
+   int eviction_count;
+
+   std::atomic<bool> preloading;
+   std::mutex queue_mutex; // guards the preload queue and the loader thread
+   std::condition_variable queued; // wakes the loader
+   std::condition_variable drained; // wakes wait()
+   std::vector<entry*> pending; // queued for the loader
+   int decoding; // textures of the loader's current batch
+   bool stopping;
+   std::thread loader; // started by the first preload()
+};
+
+inline texture_cache::lease texture_cache::acquire(entry& e)
+{
+   // only write the stamp when it changes, so that threads reading the same texture
+   // do not keep taking its cache line from each other
+   uint64_t now = clock.load(std::memory_order_relaxed);
+   if (e.last_use.load(std::memory_order_relaxed) != now) e.last_use.store(now, std::memory_order_relaxed);
+
+   // lease first, then look, the other way around from evict(). The lease goes in the
+   // thread's own slot unless the thread already holds one there.
+   reader_slot* slot = thread_slot();
+   if (slot && !slot->reading.load(std::memory_order_relaxed))
+   {
+      slot->reading.store(&e);
+      const mipmap* texels = e.texels.load();
+      if (texels) return lease(&slot->reading, texels);
+      slot->reading.store(nullptr, std::memory_order_release);
+   }
+   else
+   {
+      e.readers.fetch_add(1);
+      const mipmap* texels = e.texels.load();
+      if (texels) return lease(&e, texels);
+      e.readers.fetch_sub(1, std::memory_order_release);
+   }
+   if (e.failed) return lease();
+   return load(e);
+}
+
+inline texture_cache::lease texture_cache::load(entry& e)
+{
+   // one thread decodes the file while the others that need it wait
+   std::lock_guard<std::mutex> loading_guard(e.loading);
+   e.readers.fetch_add(1);
+   const mipmap* texels = e.texels.load();
+   if (texels) return lease(&e, texels);
+
+   mipmap* loaded = e.failed ? nullptr : decode(e.file, e.texels_format);
+   if (!loaded)
+   {
+      if (!e.failed) std::cerr << "ERROR: Could not load texture image file '" << e.file << "'.\n";
+      e.failed = true;
+      e.readers.fetch_sub(1, std::memory_order_release);
+      return lease();
+   }
+
+   std::lock_guard<std::mutex> guard(mutex);
+   texels = e.texels.load();
+   if (texels)
+   {
+      // an eviction that had taken the texels away for a moment put them back
+      delete loaded;
+      return lease(&e, texels);
+   }
+   make_room(loaded->memory_bytes());
+   e.bytes = loaded->memory_bytes();
+   e.last_use = clock.fetch_add(1) + 1;
+   e.texels.store(loaded);
+   resident.push_back(&e);
+   used_bytes += e.bytes;
+   load_count++;
+   return lease(&e, loaded);
+}
+
+#endif
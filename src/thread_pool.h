@@ -0,0 +1,162 @@
+// thread_pool.h
+// A small work-stealing thread pool. Each worker owns a queue of task indices;
+// when its own queue runs dry it steals from the back of the other queues,
+// so expensive tasks on one worker do not leave the others idle.
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+public:
+   // task(index, worker) where worker is in [0, size())
+   typedef std::function<void(int, int)> task_fn;
+
+   // num_threads <= 0 uses one thread per hardware core
+   explicit thread_pool(int num_threads = 0) : job(nullptr), generation(0), working(0), stop(false)
+   {
+      if (num_threads <= 0)
+      {
+         num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+      }
+
+      for (int w = 0; w < num_threads; w++)
+      {
+         queues.push_back(std::unique_ptr<work_queue>(new work_queue()));
+      }
+
+      // the calling thread works as worker 0
+      for (int w = 1; w < num_threads; w++)
+      {
+         threads.push_back(std::thread(&thread_pool::worker_loop, this, w));
+      }
+   }
+
+   ~thread_pool()
+   {
+      {
+         std::lock_guard<std::mutex> guard(mutex);
+         stop = true;
+      }
+      wake.notify_all();
+      for (auto& t : threads)
+      {
+         t.join();
+      }
+   }
+
+   int size() const { return (int) queues.size(); }
+
+   // run task for every index in [0, count) and wait until all of them are finished
+   void parallel_for(int count, const task_fn& task)
+   {
+      // deal the indices out round-robin so every worker starts with a mixed share;
+      // all workers are idle here, so the queues can be filled without contention
+      for (int i = 0; i < count; i++)
+      {
+         queues[i % queues.size()]->tasks.push_back(i);
+      }
+
+      {
+         std::lock_guard<std::mutex> guard(mutex);
+         job = &task;
+         generation++;
+         working = (int) threads.size();
+      }
+      wake.notify_all();
+
+      run(0, task);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [this] { return working == 0; });
+      job = nullptr;
+   }
+
+private:
+   struct work_queue {
+      std::mutex lock;
+      std::deque<int> tasks;
+   };
+
+   void worker_loop(int w)
+   {
+      unsigned long long seen = 0;
+      for (;;)
+      {
+         const task_fn* task = nullptr;
+         {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+            task = job;
+         }
+
+         run(w, *task);
+
+         std::lock_guard<std::mutex> guard(mutex);
+         if (--working == 0)
+         {
+            done.notify_all();
+         }
+      }
+   }
+
+   void run(int w, const task_fn& task)
+   {
+      int index;
+      while (pop(w, index) || steal(w, index))
+      {
+         task(index, w);
+      }
+   }
+
+   // take the next task from the front of our own queue
+   bool pop(int w, int& index)
+   {
+      work_queue& q = *queues[w];
+      std::lock_guard<std::mutex> guard(q.lock);
+      if (q.tasks.empty()) return false;
+      index = q.tasks.front();
+      q.tasks.pop_front();
+      return true;
+   }
+
+   // take a task from the back of another worker's queue
+   bool steal(int w, int& index)
+   {
+      int n = (int) queues.size();
+      for (int k = 1; k < n; k++)
+      {
+         work_queue& q = *queues[(w + k) % n];
+         std::lock_guard<std::mutex> guard(q.lock);
+         if (q.tasks.empty()) continue;
+         index = q.tasks.back();
+         q.tasks.pop_back();
+         return true;
+      }
+      return false;
+   }
+
+private:
+   std::vector<std::unique_ptr<work_queue>> queues;
+   std::vector<std::thread> threads;
+
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::condition_variable done;
+   const task_fn* job;
+   unsigned long long generation;
+   int working;
+   bool stop;
+};
+
+#endif
@@ -7,11 +7,11 @@
 
 class triangle : public hittable {
 public:
-   triangle() : a(0), b(0), c(0), mat_ptr(0) {}
+   triangle() : a(0), b(0), c(0), mat_id(0) {}
    triangle(const glm::point3& v0, const glm::point3& v1, const glm::point3& v2, 
-      std::shared_ptr<material> m) : a(v0), b(v1), c(v2), mat_ptr(m) {};
+      uint32_t m) : a(v0), b(v1), c(v2), mat_id(m) {};
 
-   virtual bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const override
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override
    {
        glm::vec3 e1 = b - a;
        glm::vec3 e2 = c - a;
@@ -36,26 +36,60 @@ public:
        if (v < 0.0 || ((u + v) > 1.0)) return false;
 
        float t = f * (glm::dot(e2, q));
-       if (t < 0.0) return false;
+       if (t < t_min || t > t_max) return false;
 
        rec.t = t; // save the time when we hit the object
-       rec.p = r.at(t); // ray.origin + t * ray.direction
-       rec.mat_ptr = mat_ptr;
+       rec.mat_id = mat_id;
+       rec.object = this;
+       return true;
+   }
+
+   virtual void finalize_hit(const ray& r, hit_record& rec) const override
+   {
+       rec.p = r.at(rec.t); // ray.origin + t * ray.direction
 
        // save normal
-       
-       glm::vec3 outward_normal = normalize(normal_vector); // compute unit length normal
+       glm::vec3 outward_normal = normalize(glm::cross(b - a, c - a)); // compute unit length normal
        rec.set_face_normal(r, outward_normal);
        get_uv_coordinates(a, b, c, rec.p, rec.u, rec.v);
+   }
 
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override
+   {
+       // pad the box so that axis-aligned triangles do not produce a flat box
+       const glm::vec3 pad(0.0001f);
+       output_box = aabb(glm::min(a, glm::min(b, c)) - pad, glm::max(a, glm::max(b, c)) + pad);
        return true;
    }
 
+   // points are sampled uniformly over the area, converted to a density over solid angle
+   virtual float pdf_value(const glm::point3& origin, const glm::vec3& direction) const override
+   {
+       hit_record rec;
+       if (!intersect(ray(origin, direction), 0.001f, infinity, rec)) return 0;
+
+       glm::vec3 n = glm::cross(b - a, c - a);
+       float area = 0.5f * glm::length(n);
+       float dist_squared = rec.t * rec.t * glm::dot(direction, direction);
+       float cosine = fabs(glm::dot(direction, n)) / (glm::length(direction) * 2.0f * area);
+       if (cosine < 0.000001f) return 0;
+       return dist_squared / (cosine * area);
+   }
+
+   virtual glm::vec3 random(const glm::point3& origin, sampler& gen) const override
+   {
+       glm::vec2 u = gen.get_2d();
+       float r1 = sqrt(u.x);
+       float r2 = u.y;
+       glm::point3 p = (1 - r1) * a + r1 * (1 - r2) * b + r1 * r2 * c;
+       return p - origin;
+   }
+
 public:
    glm::point3 a;
    glm::point3 b;
    glm::point3 c;
-   std::shared_ptr<material> mat_ptr;
+   uint32_t mat_id; // index into the scene's material_table
 
 private:
     static void get_uv_coordinates(const glm::point3& vertex1, const glm::point3& vertex2, const glm::point3& vertex3, const glm::point3& hitPoint, float& u, float& v) {
@@ -0,0 +1,240 @@
+// triangle_mesh.h
+// An indexed triangle mesh: vertex positions, normals and texture coordinates
+// are stored once in shared buffers and each triangle is three 32-bit indices,
+// instead of one triangle object with its own copy of three vertices. The mesh
+// is a single hittable with its own bounding volume hierarchy over the triangles,
+// stored as a flat array of nodes. Each leaf is a triangle_packet, tested with one
+// watertight SIMD test (triangle_packet.h). See obj_loader.h to fill one from a file.
+
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "hittable.h"
+#include "bvh.h"
+#include "triangle_packet.h"
+#include "AGLM.h"
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class triangle_mesh : public hittable {
+public:
+   triangle_mesh(uint32_t m = 0) : mat_id(m) {}
+
+   // Builds the hierarchy over the triangles. Call it after the buffers are
+   // filled or changed; load_obj() calls it for you. Reorders the triangles.
+   void build();
+
+   size_t num_triangles() const { return indices.size() / 3; }
+
+   // bytes used by the buffers and the hierarchy
+   size_t memory_bytes() const {
+      return positions.capacity() * sizeof(glm::point3) + normals.capacity() * sizeof(glm::vec3) +
+         uvs.capacity() * sizeof(glm::vec2) + indices.capacity() * sizeof(uint32_t) +
+         nodes.capacity() * sizeof(node) + packets.capacity() * sizeof(triangle_packet);
+   }
+
+   virtual bool intersect(const ray& r, float t_min, float t_max, hit_record& rec) const override;
+   virtual void finalize_hit(const ray& r, hit_record& rec) const override;
+   virtual bool bounding_box(float time0, float time1, aabb& output_box) const override;
+
+   // most triangles in a leaf of the hierarchy, one packet
+   static const int max_leaf_size = triangle_packet::width;
+
+public:
+   std::vector<glm::point3> positions;
+   std::vector<glm::vec3> normals; // one per position, or empty to use the face normals;
+                                   // triangles with a zero normal at a corner use theirs
+   std::vector<glm::vec2> uvs; // one per position, or empty to use barycentric coordinates
+   std::vector<uint32_t> indices; // three per triangle, into the vertex buffers
+   uint32_t mat_id; // index into the scene's material_table
+
+private:
+   struct node {
+      aabb box;
+      uint32_t offset; // leaf: index of its packet; inner: index of the second child (the first is next)
+      uint16_t count; // triangles in a leaf, 0 for inner nodes
+      uint16_t axis; // split axis of an inner node
+   };
+
+   struct build_triangle {
+      aabb box;
+      glm::point3 centroid;
+      uint32_t index;
+   };
+
+   uint32_t build_node(std::vector<build_triangle>& tris, size_t start, size_t end);
+
+   std::vector<node> nodes; // nodes[0] is the root
+   std::vector<triangle_packet> packets; // the triangles of each leaf
+};
+
+inline void triangle_mesh::build()
+{
+   nodes.clear();
+   packets.clear();
+   if (indices.empty()) return;
+
+   std::vector<build_triangle> tris(num_triangles());
+   for (size_t k = 0; k < tris.size(); k++)
+   {
+      for (int i = 0; i < 3; i++) tris[k].box.expand(positions[indices[3 * k + i]]);
+      tris[k].centroid = tris[k].box.centroid();
+      // pad the box so that axis-aligned triangles do not produce a flat box
+      tris[k].box.expand(tris[k].box.min() - glm::vec3(0.0001f));
+      tris[k].box.expand(tris[k].box.max() + glm::vec3(0.0001f));
+      tris[k].index = (uint32_t) k;
+   }
+
+   nodes.reserve(2 * tris.size() / max_leaf_size + 1);
+   build_node(tris, 0, tris.size());
+   nodes.shrink_to_fit();
+   packets.shrink_to_fit();
+
+   // store the triangles in leaf order, so that every leaf is a contiguous range
+   std::vector<uint32_t> sorted(indices.size());
+   for (size_t k = 0; k < tris.size(); k++)
+   {
+      for (int i = 0; i < 3; i++) sorted[3 * k + i] = indices[3 * tris[k].index + i];
+   }
+   indices.swap(sorted);
+}
+
+inline uint32_t triangle_mesh::build_node(std::vector<build_triangle>& tris, size_t start, size_t end)
+{
+   uint32_t index = (uint32_t) nodes.size();
+   nodes.push_back(node());
+
+   aabb box, centroid_bounds;
+   for (size_t i = start; i < end; i++)
+   {
+      box.expand(tris[i].box);
+      centroid_bounds.expand(tris[i].centroid);
+   }
+   nodes[index].box = box;
+
+   if (end - start <= (size_t) max_leaf_size)
+   {
+      triangle_packet packet;
+      for (size_t i = start; i < end; i++)
+      {
+         const uint32_t* v = &indices[3 * tris[i].index];
+         packet.set(int(i - start), positions[v[0]], positions[v[1]], positions[v[2]], (uint32_t) i);
+      }
+      nodes[index].offset = (uint32_t) packets.size();
+      nodes[index].count = (uint16_t) (end - start);
+      nodes[index].axis = 0;
+      packets.push_back(packet);
+      return index;
+   }
+
+   int axis = 0;
+   size_t mid = sah_split(tris, start, end, centroid_bounds, axis);
+   build_node(tris, start, mid);
+   uint32_t second = build_node(tris, mid, end);
+   nodes[index].offset = second;
+   nodes[index].count = 0;
+   nodes[index].axis = (uint16_t) axis;
+   return index;
+}
+
+inline bool triangle_mesh::intersect(const ray& r, float t_min, float t_max, hit_record& rec) const
+{
+   if (nodes.empty()) return false;
+
+   watertight_ray wr(r);
+   bool hit_anything = false;
+   float closest_so_far = t_max;
+   uint32_t stack[64];
+   int stack_size = 0;
+   uint32_t current = 0;
+   while (true)
+   {
+      const node& n = nodes[current];
+      if (n.box.hit(r, t_min, closest_so_far))
+      {
+         if (n.count > 0)
+         {
+            int lane = packets[n.offset].intersect(wr, t_min, closest_so_far);
+            if (lane >= 0)
+            {
+               hit_anything = true;
+               rec.prim = n.offset * triangle_packet::width + lane;
+            }
+         }
+         else
+         {
+            // visit the child on the near side of the split first
+            uint32_t first = current + 1;
+            uint32_t second = n.offset;
+            if (r.dir[n.axis] < 0.0f) std::swap(first, second);
+            stack[stack_size++] = second;
+            current = first;
+            continue;
+         }
+      }
+      if (stack_size == 0) break;
+      current = stack[--stack_size];
+   }
+
+   if (!hit_anything) return false;
+   rec.t = closest_so_far;
+   rec.mat_id = mat_id;
+   rec.object = this;
+   return true;
+}
+
+inline void triangle_mesh::finalize_hit(const ray& r, hit_record& rec) const
+{
+   // rec.prim is the packet and lane of the triangle
+   const triangle_packet& packet = packets[rec.prim / triangle_packet::width];
+   int lane = rec.prim % triangle_packet::width;
+   uint32_t tri = packet.tri[lane];
+   uint32_t i0 = indices[3 * tri];
+   uint32_t i1 = indices[3 * tri + 1];
+   uint32_t i2 = indices[3 * tri + 2];
+
+   float t, b0 = 1.0f, b1 = 0.0f, b2 = 0.0f;
+   rec.p = r.at(rec.t);
+   if (!intersect_watertight(watertight_ray(r), packet.vertex(lane, 0), packet.vertex(lane, 1), packet.vertex(lane, 2),
+      -infinity, infinity, t, b0, b1, b2))
+   {
+      // the offset rays of ray differentials (hittable.h) may pass outside the
+      // triangle: extend the barycentric coordinates over its plane
+      glm::vec3 e1 = packet.vertex(lane, 1) - packet.vertex(lane, 0);
+      glm::vec3 e2 = packet.vertex(lane, 2) - packet.vertex(lane, 0);
+      glm::vec3 n = glm::cross(e1, e2);
+      glm::vec3 to_p = rec.p - packet.vertex(lane, 0);
+      float area = glm::dot(n, n);
+      if (area > 0.0f)
+      {
+         b1 = glm::dot(glm::cross(to_p, e2), n) / area;
+         b2 = glm::dot(glm::cross(e1, to_p), n) / area;
+         b0 = 1.0f - b1 - b2;
+      }
+   }
+
+   rec.set_face_normal(r, packet.normal(lane));
+   if (!normals.empty() && normals[i0] != glm::vec3(0.0f) && normals[i1] != glm::vec3(0.0f) &&
+      normals[i2] != glm::vec3(0.0f))
+   {
+      // smooth shading normal, on the same side as the face normal
+      glm::vec3 n = glm::normalize(b0 * normals[i0] + b1 * normals[i1] + b2 * normals[i2]);
+      rec.normal = rec.front_face ? n : -n;
+   }
+
+   glm::vec2 uv = uvs.empty() ? glm::vec2(b1, b2) : b0 * uvs[i0] + b1 * uvs[i1] + b2 * uvs[i2];
+   rec.u = uv.x;
+   rec.v = uv.y;
+}
+
+inline bool triangle_mesh::bounding_box(float time0, float time1, aabb& output_box) const
+{
+   if (nodes.empty()) return false;
+   output_box = nodes[0].box;
+   return true;
+}
+
+#endif
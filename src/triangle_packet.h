@@ -0,0 +1,157 @@
+// triangle_packet.h
+// Leaf format for triangles: simd::width triangles (4 with SSE, 8 with AVX, 16 with AVX-512) with
+// their vertices in structure-of-arrays form and their unit normals computed when
+// the packet is built, tested against a ray all at once.
+//
+// The test is the watertight algorithm of Woop, Benthin and Wald ("Watertight
+// Ray/Triangle Intersection", 2013). The ray is sheared so that it runs along +z
+// from the origin, and the 2D edge functions of the sheared vertices decide the
+// hit. Two triangles that share an edge compute that edge function from the same
+// values, so a ray through the edge cannot slip between them. The test works on
+// vertices rather than precomputed edges, since edges computed ahead of time would
+// give each triangle its own rounding.
+
+#ifndef TRIANGLE_PACKET_H
+#define TRIANGLE_PACKET_H
+
+#include "AGLM.h"
+#include "ray.h"
+#include "simd.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+// per-ray setup of the watertight test, shared by all the triangles a ray visits
+struct watertight_ray {
+   watertight_ray(const ray& r) : org(r.origin()) {
+      glm::vec3 d = r.direction();
+      glm::vec3 a = glm::abs(d);
+      kz = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+      kx = (kz + 1) % 3;
+      ky = (kx + 1) % 3;
+      if (d[kz] < 0.0f) std::swap(kx, ky); // keep the winding of the triangles
+      sx = d[kx] / d[kz];
+      sy = d[ky] / d[kz];
+      sz = 1.0f / d[kz];
+   }
+
+   glm::point3 org;
+   int kx, ky, kz; // the axis along the ray is kz
+   float sx, sy, sz; // shear
+};
+
+// One ray against the triangle (a, b, c). On a hit with t in [t_min, t_max],
+// returns t and the barycentric coordinates (b0, b1, b2) of a, b and c.
+inline bool intersect_watertight(const watertight_ray& r, const glm::point3& a, const glm::point3& b,
+   const glm::point3& c, float t_min, float t_max, float& t, float& b0, float& b1, float& b2)
+{
+   glm::vec3 A = a - r.org;
+   glm::vec3 B = b - r.org;
+   glm::vec3 C = c - r.org;
+   float ax = A[r.kx] - r.sx * A[r.kz];
+   float ay = A[r.ky] - r.sy * A[r.kz];
+   float bx = B[r.kx] - r.sx * B[r.kz];
+   float by = B[r.ky] - r.sy * B[r.kz];
+   float cx = C[r.kx] - r.sx * C[r.kz];
+   float cy = C[r.ky] - r.sy * C[r.kz];
+
+   // edge functions; all of the same sign (or zero) inside the triangle
+   float u = cx * by - cy * bx;
+   float v = ax * cy - ay * cx;
+   float w = bx * ay - by * ax;
+   if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) return false;
+
+   float det = u + v + w;
+   if (det == 0.0f) return false;
+   float z = u * (r.sz * A[r.kz]) + v * (r.sz * B[r.kz]) + w * (r.sz * C[r.kz]);
+   t = z / det;
+   if (!(t >= t_min && t <= t_max)) return false;
+
+   b0 = u / det;
+   b1 = v / det;
+   b2 = w / det;
+   return true;
+}
+
+struct triangle_packet {
+   static const int width = simd::width;
+
+   triangle_packet() {
+      // empty lanes have NaN vertices, which never hit
+      const float nan = std::numeric_limits<float>::quiet_NaN();
+      for (int lane = 0; lane < width; lane++)
+      {
+         for (int i = 0; i < 3; i++)
+         {
+            for (int axis = 0; axis < 3; axis++) v[i][axis][lane] = nan;
+            n[i][lane] = 0.0f;
+         }
+         tri[lane] = 0;
+      }
+   }
+
+   void set(int lane, const glm::point3& a, const glm::point3& b, const glm::point3& c, uint32_t index) {
+      tri[lane] = index;
+      glm::vec3 normal = glm::cross(b - a, c - a);
+      float length = glm::length(normal);
+      // a triangle without area stays an empty lane: its edge functions are all
+      // zero in exact arithmetic, but not once the compiler fuses them into FMAs
+      if (!(length > 0.0f)) return;
+
+      const glm::point3* p[3] = { &a, &b, &c };
+      for (int i = 0; i < 3; i++)
+      {
+         for (int axis = 0; axis < 3; axis++) v[i][axis][lane] = (*p[i])[axis];
+      }
+      for (int axis = 0; axis < 3; axis++) n[axis][lane] = normal[axis] / length;
+   }
+
+   glm::point3 vertex(int lane, int i) const { return glm::point3(v[i][0][lane], v[i][1][lane], v[i][2][lane]); }
+   glm::vec3 normal(int lane) const { return glm::vec3(n[0][lane], n[1][lane], n[2][lane]); }
+
+   // the lane of the closest hit with t in [t_min, t_max], or -1; on a hit t_max becomes its t
+   int intersect(const watertight_ray& r, float t_min, float& t_max) const;
+
+   float v[3][3][width]; // [vertex][axis][lane]
+   float n[3][width]; // unit geometric normal, [axis][lane]
+   uint32_t tri[width]; // index of the triangle each lane holds
+};
+
+// intersect_watertight() on all lanes at once
+inline int triangle_packet::intersect(const watertight_ray& r, float t_min, float& t_max) const
+{
+   using namespace simd;
+
+   vfloat ox(r.org[r.kx]), oy(r.org[r.ky]), oz(r.org[r.kz]);
+   vfloat sx(r.sx), sy(r.sy), sz(r.sz), zero(0.0f);
+
+   vfloat az = load(v[0][r.kz]) - oz;
+   vfloat bz = load(v[1][r.kz]) - oz;
+   vfloat cz = load(v[2][r.kz]) - oz;
+   vfloat ax = (load(v[0][r.kx]) - ox) - sx * az;
+   vfloat ay = (load(v[0][r.ky]) - oy) - sy * az;
+   vfloat bx = (load(v[1][r.kx]) - ox) - sx * bz;
+   vfloat by = (load(v[1][r.ky]) - oy) - sy * bz;
+   vfloat cx = (load(v[2][r.kx]) - ox) - sx * cz;
+   vfloat cy = (load(v[2][r.ky]) - oy) - sy * cz;
+
+   vfloat eu = cx * by - cy * bx;
+   vfloat ev = ax * cy - ay * cx;
+   vfloat ew = bx * ay - by * ax;
+   vmask negative = (eu < zero) | (ev < zero) | (ew < zero);
+   vmask positive = (eu > zero) | (ev > zero) | (ew > zero);
+
+   vfloat det = eu + ev + ew;
+   vfloat z = eu * (sz * az) + ev * (sz * bz) + ew * (sz * cz);
+   vfloat t = z / det;
+   vmask found = andnot(negative & positive, (det != zero) & (t >= vfloat(t_min)) & (t <= vfloat(t_max)));
+   if (!bits(found)) return -1;
+
+   t = select(found, t, vfloat(infinity));
+   t_max = reduce_min(t);
+   return first_lane(bits(found & (t == vfloat(t_max))));
+}
+
+#endif
@@ -0,0 +1,268 @@
+// wavefront.h
+// Wavefront version of ray_color (integrator.h). Instead of following one path
+// from the camera to its end, a tile's worth of paths advances one bounce at a
+// time in stages:
+//   1. generate: one camera ray per pixel sample
+//   2. intersect: all queued rays against the scene; misses pick up the sky
+//   3. sort: hits are grouped by material
+//   4. shade: scatter every hit, one material at a time, and queue the continuations
+// Each stage runs over a large batch kept in structure-of-arrays queues, so each
+// stage's code and data stay in cache, and shading calls the same material
+// over and over.
+//
+// A path draws its samples from (pixel, sample, bounce) exactly like ray_color
+// and its color is stored per sample, then summed in sample order, so the
+// images match render() with ray_color exactly. The queues also keep the ray
+// differentials (ray.h), so textures are filtered the same way.
+
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "AGLM.h"
+#include "ray.h"
+#include "hittable.h"
+#include "material.h"
+#include "scene.h"
+#include "sampler.h"
+#include "renderer.h"
+#include "integrator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <typeinfo>
+#include <vector>
+
+// rays of the paths in flight, as separate arrays per field
+struct ray_queue {
+   std::vector<glm::point3> origin;
+   std::vector<glm::vec3> direction;
+   std::vector<float> time;
+   std::vector<char> has_differentials;
+   std::vector<glm::point3> rx_origin, ry_origin; // set when has_differentials
+   std::vector<glm::vec3> rx_direction, ry_direction;
+   std::vector<glm::color> throughput;
+   std::vector<int> path; // slot of the path in the tile, pixel * samples_per_pixel + sample
+
+   int size() const { return (int) path.size(); }
+   bool empty() const { return path.empty(); }
+
+   void push(const ray& r, const glm::color& weight, int slot) {
+      origin.push_back(r.origin());
+      direction.push_back(r.direction());
+      time.push_back(r.getTime());
+      has_differentials.push_back(r.has_differentials);
+      rx_origin.push_back(r.rx_orig);
+      rx_direction.push_back(r.rx_dir);
+      ry_origin.push_back(r.ry_orig);
+      ry_direction.push_back(r.ry_dir);
+      throughput.push_back(weight);
+      path.push_back(slot);
+   }
+
+   ray get(int k) const {
+      ray r(origin[k], direction[k], time[k]);
+      if (has_differentials[k]) r.set_differentials(rx_origin[k], rx_direction[k], ry_origin[k], ry_direction[k]);
+      return r;
+   }
+
+   void clear() {
+      origin.clear();
+      direction.clear();
+      time.clear();
+      has_differentials.clear();
+      rx_origin.clear();
+      rx_direction.clear();
+      ry_origin.clear();
+      ry_direction.clear();
+      throughput.clear();
+      path.clear();
+   }
+};
+
+// orders hits by material type, then by material
+struct shade_key {
+   size_t type;
+   uint32_t mat_id;
+   int hit;
+
+   bool operator<(const shade_key& other) const {
+      if (type != other.type) return type < other.type;
+      if (mat_id != other.mat_id) return mat_id < other.mat_id;
+      return hit < other.hit;
+   }
+};
+
+// hits found by the intersect stage, waiting to be shaded
+struct hit_queue {
+   std::vector<hit_record> rec;
+   std::vector<int> ray_index; // index into the ray queue
+   std::vector<shade_key> order; // sorted before shading
+
+   bool empty() const { return ray_index.empty(); }
+
+   void clear() {
+      rec.clear();
+      ray_index.clear();
+      order.clear();
+   }
+};
+
+// the queues of one worker, reused from tile to tile
+struct wavefront_state {
+   wavefront_state(const sampler& s) : gen(s) {}
+
+   sampler gen;
+   ray_queue rays;
+   ray_queue next;
+   hit_queue hits;
+   std::vector<glm::color> radiance; // final color of every path slot
+   long long rays_traced = 0;
+};
+
+// about how many paths are traced together; tiles are sized to hold this many
+// samples, big enough for long runs per material but small enough for the queues
+// to stay in cache
+const int wavefront_paths = 4096;
+
+// Shade the paths of pixels [x0, x1) x [y0, y1). camera_ray(i, j, gen) returns the
+// camera ray of a sample of pixel (i, j), as the first part of a render() sample function.
+template <class CameraFn>
+void render_wavefront_tile(agl::ppm_image& image, const render_settings& settings,
+   const scene& world, const path_settings& path, const CameraFn& camera_ray,
+   int x0, int y0, int x1, int y1, wavefront_state& state)
+{
+   int spp = settings.samples_per_pixel;
+   int tw = x1 - x0;
+   int paths = tw * (y1 - y0) * spp;
+   sampler& gen = state.gen;
+   ray_queue& rays = state.rays;
+   hit_queue& hits = state.hits;
+
+   // slot k is sample (k % spp) of pixel (k / spp) of the tile
+   auto start_path = [&](int slot)
+   {
+      int p = slot / spp;
+      gen.start_pixel_sample(x0 + p % tw, y0 + p / tw, slot % spp);
+   };
+
+   // generate
+   state.radiance.assign(paths, glm::color(0));
+   rays.clear();
+   for (int slot = 0; slot < paths; slot++)
+   {
+      int p = slot / spp;
+      start_path(slot);
+      rays.push(camera_ray(x0 + p % tw, y0 + p / tw, gen), glm::color(1), slot);
+   }
+
+   for (int bounce = 1; bounce <= path.max_depth && !rays.empty(); bounce++)
+   {
+      // intersect
+      hits.clear();
+      for (int k = 0; k < rays.size(); k++)
+      {
+         hit_record rec;
+         ray r = rays.get(k);
+         if (world.hit(r, 0.001f, infinity, rec))
+         {
+            hits.rec.push_back(rec);
+            hits.ray_index.push_back(k);
+         }
+         else
+         {
+            state.radiance[rays.path[k]] = rays.throughput[k] * sky_color(r);
+         }
+      }
+      state.rays_traced += rays.size();
+
+      // sort by material type, then by material, so that shading runs the same code
+      // and reads the same textures for long stretches
+      for (int h = 0; h < (int) hits.ray_index.size(); h++)
+      {
+         uint32_t id = hits.rec[h].mat_id;
+         shade_key key = { typeid(world.materials[id]).hash_code(), id, h };
+         hits.order.push_back(key);
+      }
+      std::sort(hits.order.begin(), hits.order.end());
+
+      // shade
+      state.next.clear();
+      for (const auto& entry : hits.order)
+      {
+         int h = entry.hit;
+         int k = hits.ray_index[h];
+         int slot = rays.path[k];
+         const hit_record& rec = hits.rec[h];
+
+         start_path(slot);
+         gen.start_bounce(bounce);
+         ray scattered;
+         glm::color attenuation;
+         glm::color throughput = rays.throughput[k];
+         if (!world.material_of(rec).scatter(rays.get(k), rec, attenuation, scattered, gen))
+         {
+            state.radiance[slot] = throughput * attenuation;
+            continue;
+         }
+
+         throughput *= attenuation;
+         if (path.russian_roulette(throughput, bounce, gen))
+         {
+            state.next.push(scattered, throughput, slot);
+         }
+      }
+      std::swap(rays, state.next);
+   }
+
+   // paths still in flight after max_depth bounces end with no light, as in ray_color
+   for (int p = 0; p < paths / spp; p++)
+   {
+      glm::color c(0);
+      for (int s = 0; s < spp; s++)
+      {
+         c += state.radiance[p * spp + s];
+      }
+      image.set_vec3(y0 + p / tw, x0 + p % tw, normalize_color(c, spp));
+   }
+}
+
+// Render the image with the wavefront version of ray_color(r, world, path, gen).
+// Uses settings.samples_per_pixel, num_threads and sampling; adaptive sampling is
+// not supported here.
+template <class CameraFn>
+render_stats render_wavefront(agl::ppm_image& image, const render_settings& settings,
+   const scene& world, const path_settings& path, const CameraFn& camera_ray)
+{
+   int width = image.width();
+   int height = image.height();
+   int tile = glm::clamp(int(std::sqrt(wavefront_paths / std::max(1, settings.samples_per_pixel))), 4, 64);
+   int tiles_x = (width + tile - 1) / tile;
+   int tiles_y = (height + tile - 1) / tile;
+
+   auto start = std::chrono::steady_clock::now();
+
+   thread_pool pool(settings.num_threads);
+   std::vector<wavefront_state> workers(pool.size(),
+      wavefront_state(sampler(settings.sampling, width, height, settings.samples_per_pixel)));
+
+   pool.parallel_for(tiles_x * tiles_y, [&](int index, int worker)
+   {
+      int x0 = (index % tiles_x) * tile;
+      int y0 = (index / tiles_x) * tile;
+      render_wavefront_tile(image, settings, world, path, camera_ray,
+         x0, y0, std::min(x0 + tile, width), std::min(y0 + tile, height), workers[worker]);
+   });
+
+   render_stats stats;
+   stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   stats.threads = pool.size();
+   stats.tiles = tiles_x * tiles_y;
+   stats.samples = (long long) width * height * settings.samples_per_pixel;
+   for (const auto& w : workers) stats.rays += w.rays_traced;
+
+   print_render_stats(stats, width, height, "wavefront");
+   return stats;
+}
+
+#endif